@@ -0,0 +1,470 @@
+/*
+	---- DICTBENCH.C, a benchmark of the LZW dictionary structures ----
+
+	Records the (prefix, character) lookups and the inserts of real
+	compressions of the input files, then replays the trace against
+	each dictionary backend:
+
+	  bst   = the per-prefix binary tree of LZWBT.C (lzwg, lzwgt);
+	  lzc   = the LZC double hashing of LZWH.C/LZWENC.C (lzwh, lzwhc, lzwz);
+	  lp    = linear probing, key and code packed in one 64-bit slot,
+	          power-of-two table at most half full.
+
+	The trace is recorded with the string table reset of lzwhc
+	(after CODE_MAX+4096 codes), once for each table size.
+
+	For each backend and table size it reports lookups/s (fastest
+	of several runs), probes per lookup (table entries examined,
+	counting the empty one that ends a miss), cache misses per
+	lookup (perf_event_open, Linux; "n/a" when not permitted) and
+	the bytes of table memory per dictionary entry.
+
+	Usage:
+
+		dictbench [-b bits] [-r runs] [-s MB] file...
+
+	  -b bits = only this table size, 12..28 (default=12,16,20,24)
+	  -r runs = replay runs per measurement (default=3)
+	  -s MB   = record at most this many MB of input (default=16)
+
+	Build: gcc -O2 -o dictbench dictbench.c
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#if defined( __linux__ )
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+#include "lzwenc.c"
+
+/* a lookup of the trace; prefix < 0 marks a string table reset. */
+typedef struct {
+	int prefix;
+	int code;             /* the code found, or the code inserted after a miss (0 = none). */
+	unsigned char c;
+	unsigned char hit;
+} trace_entry;
+
+trace_entry *trace = NULL;
+size_t trace_len = 0, trace_lookups = 0;
+
+/* ---- recording ---- */
+
+static void trace_add( int prefix, unsigned char c, int code, int hit )
+{
+	static size_t trace_size = 0;
+
+	if ( trace_len == trace_size ) {
+		trace_size = trace_size ? 2 * trace_size : (1 << 20);
+		trace = (trace_entry *) realloc( trace, sizeof(trace_entry) * trace_size );
+		if ( !trace ) {
+			fprintf(stderr, "\nError alloc: trace.");
+			exit(0);
+		}
+	}
+	trace[ trace_len ].prefix = prefix;
+	trace[ trace_len ].code = code;
+	trace[ trace_len ].c = c;
+	trace[ trace_len++ ].hit = hit;
+	if ( prefix >= 0 ) trace_lookups++;
+}
+
+/* compresses p[0..n-1] the way lzw_match() does, logging the dictionary operations. */
+static void record_trace( lzw_dict *d, const unsigned char *p, size_t n )
+{
+	const unsigned char *end = p + n;
+	int prefix_string_code, k;
+	unsigned char c;
+
+	if ( n == 0 ) return;
+	lzw_dict_init( d );
+	trace_add( -1, 0, 0, 0 );
+	prefix_string_code = *p++;
+	while ( p < end ) {
+		c = *p++;
+		if ( (k = search_string( d, prefix_string_code, c )) != LZW_NULL ) {
+			trace_add( prefix_string_code, c, k, 1 );
+			prefix_string_code = k;
+			continue;
+		}
+		if ( d->lzw_code_cnt < d->code_MAX ) {
+			trace_add( prefix_string_code, c, d->lzw_code_cnt, 0 );
+			insert_stringENC( d, prefix_string_code, c );
+		}
+		else trace_add( prefix_string_code, c, 0, 0 );
+		if ( d->lzw_code_cnt++ == d->reset_cnt ) {
+			lzw_dict_init( d );
+			trace_add( -1, 0, 0, 0 );
+		}
+		prefix_string_code = c;
+	}
+}
+
+/* ---- bst: the binary tree of LZWBT.C ---- */
+
+#define BT_NULL  256
+
+unsigned int *bt_code, *bt_left, *bt_right;
+unsigned char *bt_char;
+int bt_size;
+
+static size_t bst_alloc( int bits )
+{
+	bt_size = 1 << bits;
+	bt_code = (unsigned int *) malloc( sizeof(int) * bt_size );
+	bt_left = (unsigned int *) malloc( sizeof(int) * bt_size );
+	bt_right = (unsigned int *) malloc( sizeof(int) * bt_size );
+	bt_char = (unsigned char *) malloc( bt_size );
+	if ( !bt_code || !bt_left || !bt_right || !bt_char ) return 0;
+	return (size_t) bt_size * (3 * sizeof(int) + 1);
+}
+
+static void bst_free( void )
+{
+	free( bt_code ); free( bt_left ); free( bt_right ); free( bt_char );
+}
+
+static void bst_reset( void )
+{
+	int i;
+
+	for ( i = 0; i < bt_size; i++ ) {
+		bt_code[ i ] = BT_NULL;
+		bt_left[ i ] = BT_NULL;
+		bt_right[ i ] = BT_NULL;
+	}
+}
+
+static inline int bst_find( int prefix, unsigned char c, uint64_t *probes )
+{
+	unsigned int code = bt_code[ prefix ];
+
+	(*probes)++;
+	while ( code != BT_NULL ) {
+		(*probes)++;
+		if ( c == bt_char[ code ] ) return (int) code;
+		else if ( c > bt_char[ code ] ) code = bt_right[ code ];
+		else code = bt_left[ code ];
+	}
+	return -1;
+}
+
+static inline void bst_insert( int prefix, unsigned char c, int new_code )
+{
+	unsigned int code = bt_code[ prefix ];
+
+	if ( code != BT_NULL ) {
+		while ( 1 ) {
+			if ( c < bt_char[ code ] ) {
+				if ( bt_left[ code ] != BT_NULL ) code = bt_left[ code ];
+				else { bt_left[ code ] = new_code; break; }
+			}
+			else {
+				if ( bt_right[ code ] != BT_NULL ) code = bt_right[ code ];
+				else { bt_right[ code ] = new_code; break; }
+			}
+		}
+	}
+	else bt_code[ prefix ] = new_code;
+	bt_char[ new_code ] = c;
+}
+
+/* ---- lzc: the double hashing of LZWENC.C ---- */
+
+lzw_dict lzc;
+
+static size_t lzc_alloc( int bits )
+{
+	if ( !lzw_dict_alloc( &lzc, bits ) ) return 0;
+	return (size_t) lzc.hash_TABLE_SIZE * (2 * sizeof(int) + 1);
+}
+
+static void lzc_free( void )
+{
+	lzw_dict_free( &lzc );
+}
+
+static void lzc_reset( void )
+{
+	lzw_dict_init( &lzc );
+}
+
+/* search_string() of LZWENC.C, counting the probes. */
+static inline int lzc_find( int prefix, unsigned char c, uint64_t *probes )
+{
+	int hindex = (c << lzc.hash_SHIFT) ^ prefix, d2;
+
+	if ( hindex == 0 ) d2 = 1;
+	else d2 = lzc.hash_TABLE_SIZE - hindex;
+	do {
+		(*probes)++;
+		if ( lzc.code[ hindex ] == LZW_NULL ) break;
+		if ( lzc.prefix[ hindex ] == prefix && lzc.character[ hindex ] == c )
+			return lzc.code[ hindex ];
+		if ( (hindex -= d2) < 0 ) hindex += lzc.hash_TABLE_SIZE;
+	} while ( 1 );
+	return -1;
+}
+
+static inline void lzc_insert( int prefix, unsigned char c, int new_code )
+{
+	lzc.lzw_code_cnt = new_code;
+	insert_stringENC( &lzc, prefix, c );
+}
+
+/* ---- lp: linear probing, slot = (prefix << 8 | c) << 28 | code; 0 = empty ---- */
+
+uint64_t *lp_table;
+int lp_bits;
+size_t lp_mask;
+
+static size_t lp_alloc( int bits )
+{
+	lp_bits = bits + 1;
+	lp_mask = ((size_t) 1 << lp_bits) - 1;
+	lp_table = (uint64_t *) malloc( sizeof(uint64_t) << lp_bits );
+	if ( !lp_table ) return 0;
+	return sizeof(uint64_t) << lp_bits;
+}
+
+static void lp_free( void )
+{
+	free( lp_table );
+}
+
+static void lp_reset( void )
+{
+	memset( lp_table, 0, sizeof(uint64_t) << lp_bits );
+}
+
+#define LP_KEY(p,c)   (((uint64_t) (p) << 8) | (c))
+#define LP_HASH(k)    ((size_t) (((k) * 0x9E3779B97F4A7C15ULL) >> (64 - lp_bits)))
+
+static inline int lp_find( int prefix, unsigned char c, uint64_t *probes )
+{
+	uint64_t key = LP_KEY( prefix, c ), slot;
+	size_t i = LP_HASH( key );
+
+	while ( (*probes)++, (slot = lp_table[ i ]) != 0 ) {
+		if ( (slot >> 28) == key ) return (int) (slot & 0x0fffffff);
+		i = (i + 1) & lp_mask;
+	}
+	return -1;
+}
+
+static inline void lp_insert( int prefix, unsigned char c, int new_code )
+{
+	uint64_t key = LP_KEY( prefix, c );
+	size_t i = LP_HASH( key );
+
+	while ( lp_table[ i ] != 0 ) i = (i + 1) & lp_mask;
+	lp_table[ i ] = (key << 28) | (uint64_t) new_code;
+}
+
+/* ---- replay ---- */
+
+/*
+	Generates replay_NAME(): runs the trace against a backend and
+	returns the number of lookups whose result differs from the
+	recorded one (0 for a correct backend).
+*/
+#define REPLAY(NAME)   \
+static size_t replay_##NAME( uint64_t *probes )   \
+{   \
+	const trace_entry *t = trace, *end = trace + trace_len;   \
+	size_t bad = 0;   \
+	int k;   \
+	\
+	for ( ; t < end; t++ ) {   \
+		if ( t->prefix < 0 ) {   \
+			NAME##_reset();   \
+			continue;   \
+		}   \
+		k = NAME##_find( t->prefix, t->c, probes );   \
+		if ( t->hit ) bad += (k != t->code);   \
+		else {   \
+			bad += (k != -1);   \
+			if ( t->code ) NAME##_insert( t->prefix, t->c, t->code );   \
+		}   \
+	}   \
+	return bad;   \
+}
+
+REPLAY(bst)
+REPLAY(lzc)
+REPLAY(lp)
+
+typedef struct {
+	const char *name;
+	size_t (*alloc)( int bits );      /* returns the table bytes, 0 on error. */
+	void (*free)( void );
+	size_t (*replay)( uint64_t *probes );
+} dict_backend;
+
+static const dict_backend backends[] = {
+	{ "bst", bst_alloc, bst_free, replay_bst },
+	{ "lzc", lzc_alloc, lzc_free, replay_lzc },
+	{ "lp",  lp_alloc,  lp_free,  replay_lp  },
+};
+#define NBACKENDS (int)(sizeof(backends)/sizeof(backends[0]))
+
+/* ---- timing and cache misses ---- */
+
+static double now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* opens a cache-miss counter of this thread; returns -1 if not available. */
+static int cache_miss_open( void )
+{
+#if defined( __linux__ )
+	struct perf_event_attr pe;
+
+	memset( &pe, 0, sizeof(pe) );
+	pe.type = PERF_TYPE_HARDWARE;
+	pe.size = sizeof(pe);
+	pe.config = PERF_COUNT_HW_CACHE_MISSES;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+	return (int) syscall( __NR_perf_event_open, &pe, 0, -1, -1, 0 );
+#else
+	return -1;
+#endif
+}
+
+static void cache_miss_start( int fd )
+{
+#if defined( __linux__ )
+	if ( fd < 0 ) return;
+	ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+	ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+#endif
+}
+
+static int64_t cache_miss_stop( int fd )
+{
+	int64_t count = -1;
+
+#if defined( __linux__ )
+	if ( fd < 0 ) return -1;
+	ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+	if ( read( fd, &count, sizeof(count) ) != sizeof(count) ) count = -1;
+#endif
+	return count;
+}
+
+void usage( void )
+{
+	fprintf(stderr, "\n Usage: dictbench [-b bits] [-r runs] [-s MB] file...\n");
+	exit (0);
+}
+
+int main( int argc, char *argv[] )
+{
+	static const int default_bits[] = { 12, 16, 20, 24, 0 };
+	int one_bits[ 2 ] = { 0, 0 };
+	const int *bits = default_bits;
+	unsigned char *buf;
+	size_t max_size = (size_t) 16 << 20, n, nfiles_bytes = 0, table_bytes, bad;
+	int i, b, r, runs = 3, fd, first_file;
+	uint64_t probes;
+	int64_t misses, best_misses;
+	double t, best;
+	char miss_str[ 32 ];
+	lzw_dict rec;
+	FILE *fp;
+
+	for ( i = 1; i < argc && argv[i][0] == '-'; i++ ) {
+		if ( argv[i][1] == 0 || argv[i][2] != 0 || i+1 == argc ) usage();
+		switch ( argv[i++][1] ) {
+			case 'b': one_bits[ 0 ] = atoi( argv[i] ); bits = one_bits; break;
+			case 'r': runs = atoi( argv[i] ); break;
+			case 's': max_size = (size_t) atoi( argv[i] ) << 20; break;
+			default: usage();
+		}
+	}
+	if ( i == argc || runs < 1 || max_size == 0 ) usage();
+	if ( bits == one_bits && (one_bits[ 0 ] < 12 || one_bits[ 0 ] > 28) ) usage();
+	first_file = i;
+
+	buf = (unsigned char *) malloc( max_size );
+	if ( !buf ) {
+		fprintf(stderr, "\nError alloc: input buffer.");
+		return 0;
+	}
+	fd = cache_miss_open();
+
+	printf( "%-4s %4s %11s %10s %9s %9s %9s\n", "dict", "bits", "lookups",
+		"Mlookup/s", "probes", "misses", "B/entry" );
+
+	for ( b = 0; bits[ b ]; b++ ) {
+		/* record the trace of all the files with this table size. */
+		if ( !lzw_dict_alloc( &rec, bits[ b ] ) ) {
+			fprintf(stderr, "\nError alloc: %d-bit dictionary.", bits[ b ] );
+			return 0;
+		}
+		trace_len = trace_lookups = 0;
+		nfiles_bytes = 0;
+		for ( i = first_file; i < argc && nfiles_bytes < max_size; i++ ) {
+			if ( (fp = fopen( argv[i], "rb" )) == NULL ) {
+				fprintf(stderr, "\nError opening input file %s.", argv[i] );
+				return 0;
+			}
+			n = fread( buf, 1, max_size - nfiles_bytes, fp );
+			fclose( fp );
+			record_trace( &rec, buf, n );
+			nfiles_bytes += n;
+		}
+		lzw_dict_free( &rec );
+
+		for ( i = 0; i < NBACKENDS; i++ ) {
+			table_bytes = backends[ i ].alloc( bits[ b ] );
+			if ( !table_bytes ) {
+				fprintf(stderr, "\nError alloc: %s tables.", backends[ i ].name );
+				return 0;
+			}
+			best = 1e30; best_misses = -1;
+			for ( r = 0; r < runs; r++ ) {
+				probes = 0;
+				cache_miss_start( fd );
+				t = now();
+				bad = backends[ i ].replay( &probes );
+				t = now() - t;
+				misses = cache_miss_stop( fd );
+				if ( bad ) {
+					fprintf(stderr, "\nError: %s: %lu lookups differ from the trace.",
+						backends[ i ].name, (unsigned long) bad );
+					return 0;
+				}
+				if ( t < best ) best = t;
+				if ( misses >= 0 && (best_misses < 0 || misses < best_misses) )
+					best_misses = misses;
+			}
+			backends[ i ].free();
+
+			if ( best_misses >= 0 )
+				sprintf( miss_str, "%.3f", (double) best_misses / trace_lookups );
+			else strcpy( miss_str, "n/a" );
+			printf( "%-4s %4d %11lu %10.2f %9.3f %9s %9.2f\n", backends[ i ].name,
+				bits[ b ], (unsigned long) trace_lookups, trace_lookups / best * 1e-6,
+				(double) probes / trace_lookups, miss_str,
+				(double) table_bytes / (1 << bits[ b ]) );
+			fflush( stdout );
+		}
+	}
+	if ( fd >= 0 ) close( fd );
+	free( trace );
+	free( buf );
+	return 0;
+}
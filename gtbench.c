@@ -0,0 +1,214 @@
+/*
+	---- GTBENCH.C, a microbenchmark of the bit I/O functions ----
+
+	Measures put_nbits(), get_nbits() and get_symbol() for code
+	widths 9 to 28, and pfputc() and gfgetc() for bytes, at buffer
+	sizes (init_buffer_sizes()) 16KB to 16MB. The streams are in
+	memory (fmemopen), so there is no disk I/O; the
+	fread()/fwrite() calls at the buffer boundaries still cost one
+	memcpy each, as with a file in the page cache.
+
+	Reports ns per code (per byte for pfputc/gfgetc) and GB/s of
+	packed stream, the fastest of several runs.
+
+	Usage:
+
+		gtbench [-n codes] [-r runs] [-w width] [-b bufsize]
+
+	  -n codes   = number of codes per run (default=4194304)
+	  -r runs    = runs per measurement (default=5)
+	  -w width   = only this code width (default=9 to 28)
+	  -b bufsize = only this buffer size in KB (default=16 to 16384)
+
+	Build:
+
+		gcc -O2 -o gtbench gtbench.c                  (gtbitio3)
+		gcc -O2 -DUSE_GTBITIO2 -o gtbench2 gtbench.c  (gtbitio2)
+
+	POSIX only (fmemopen).
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined( USE_GTBITIO2 )
+	#include "gtbitio2.c"
+	#define GTBITIO_NAME "gtbitio2"
+#else
+	#include "gtbitio3.c"
+	#define GTBITIO_NAME "gtbitio3"
+#endif
+
+#define MIN_WIDTH   9
+#define MAX_WIDTH  28
+
+enum { OP_PUT_NBITS, OP_GET_NBITS, OP_GET_SYMBOL, OP_PFPUTC, OP_GFGETC };
+
+static const char *op_names[] = {
+	"put_nbits", "get_nbits", "get_symbol", "pfputc", "gfgetc"
+};
+
+static uint32_t *codes;         /* the codes to write and to check. */
+static unsigned char *stream;   /* the packed stream. */
+static size_t stream_size, ncodes;
+static volatile unsigned int sink;
+
+static double now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static FILE *open_stream( const char *mode )
+{
+	FILE *fp = fmemopen( stream, stream_size, mode );
+
+	if ( !fp ) {
+		fprintf(stderr, "\nError: fmemopen.");
+		exit(0);
+	}
+	return fp;
+}
+
+/*
+	Runs one operation over ncodes codes of the given width.
+	Returns the elapsed seconds; exits if the data read back
+	does not match the data written.
+*/
+static double run_op( int op, int width )
+{
+	size_t i, nbytes = (ncodes * width + 7) / 8;
+	unsigned int x = 0;
+	double t0, t;
+
+	switch ( op ) {
+		case OP_PUT_NBITS:
+			pOUT = open_stream( "w" );
+			init_put_buffer();
+			t0 = now();
+			for ( i = 0; i < ncodes; i++ ) put_nbits( codes[ i ], width );
+			flush_put_buffer();
+			t = now() - t0;
+			free_put_buffer();
+			fclose( pOUT );
+			break;
+		case OP_GET_NBITS:
+			gIN = open_stream( "r" );
+			t0 = now();
+			init_get_buffer();
+			for ( i = 0; i < ncodes; i++ ) x ^= get_nbits( width ) - codes[ i ];
+			t = now() - t0;
+			free_get_buffer();
+			fclose( gIN );
+			break;
+		case OP_GET_SYMBOL:
+			gIN = open_stream( "r" );
+			t0 = now();
+			init_get_buffer();
+			for ( i = 0; i < ncodes; i++ ) x ^= get_symbol( width ) - codes[ i ];
+			t = now() - t0;
+			free_get_buffer();
+			fclose( gIN );
+			break;
+		case OP_PFPUTC:
+			pOUT = open_stream( "w" );
+			init_put_buffer();
+			t0 = now();
+			for ( i = 0; i < nbytes; i++ ) pfputc( (int) i );
+			flush_put_buffer();
+			t = now() - t0;
+			free_put_buffer();
+			fclose( pOUT );
+			break;
+		default:
+			gIN = open_stream( "r" );
+			t0 = now();
+			init_get_buffer();
+			for ( i = 0; i < nbytes; i++ ) x += gfgetc();
+			t = now() - t0;
+			free_get_buffer();
+			fclose( gIN );
+			break;
+	}
+	if ( (op == OP_GET_NBITS || op == OP_GET_SYMBOL) && x != 0 ) {
+		fprintf(stderr, "\nError: %s(%d) read back wrong codes.", op_names[ op ], width );
+		exit(0);
+	}
+	sink = x;
+	return t;
+}
+
+void usage( void )
+{
+	fprintf(stderr, "\n Usage: gtbench [-n codes] [-r runs] [-w width] [-b bufsize]\n");
+	exit (0);
+}
+
+int main( int argc, char *argv[] )
+{
+	unsigned int bufsize, bmin = 16, bmax = 16384;
+	int i, r, op, width, wmin = MIN_WIDTH, wmax = MAX_WIDTH, runs = 5;
+	uint64_t seed = 0x9E3779B97F4A7C15ULL;
+	double t, best, units, nbytes;
+
+	ncodes = 4 << 20;
+	for ( i = 1; i < argc; i++ ) {
+		if ( argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 || i+1 == argc ) usage();
+		switch ( argv[i++][1] ) {
+			case 'n': ncodes = (size_t) atol( argv[i] ); break;
+			case 'r': runs = atoi( argv[i] ); break;
+			case 'w': wmin = wmax = atoi( argv[i] ); break;
+			case 'b': bmin = bmax = (unsigned) atoi( argv[i] ); break;
+			default: usage();
+		}
+	}
+	if ( ncodes == 0 || runs < 1 || wmin < MIN_WIDTH || wmax > MAX_WIDTH || bmin == 0 )
+		usage();
+
+	codes = (uint32_t *) malloc( sizeof(uint32_t) * ncodes );
+	stream_size = (ncodes * MAX_WIDTH + 7) / 8 + 1;
+	stream = (unsigned char *) malloc( stream_size );
+	if ( !codes || !stream ) {
+		fprintf(stderr, "\nError alloc: codes and stream.");
+		return 0;
+	}
+
+	fprintf(stderr, "\n%s, %lu codes, best of %d runs\n\n", GTBITIO_NAME,
+		(unsigned long) ncodes, runs);
+	printf( "%-10s %5s %8s %10s %8s\n", "op", "width", "buf KB", "ns/code", "GB/s" );
+
+	for ( bufsize = bmin; bufsize <= bmax; bufsize *= 4 ) {
+		init_buffer_sizes( bufsize * 1024 );
+		for ( width = wmin; width <= wmax; width++ ) {
+			/* random codes of the full width; xorshift64*. */
+			for ( i = 0; i < (int) ncodes; i++ ) {
+				seed ^= seed >> 12; seed ^= seed << 25; seed ^= seed >> 27;
+				codes[ i ] = (uint32_t) ((seed * 0x2545F4914F6CDD1DULL) >> (64 - width));
+			}
+			for ( op = OP_PUT_NBITS; op <= OP_GFGETC; op++ ) {
+				/* the byte functions do not depend on the width. */
+				if ( op >= OP_PFPUTC && width != wmin ) continue;
+				best = 1e30;
+				for ( r = 0; r < runs; r++ ) {
+					t = run_op( op, op >= OP_PFPUTC ? 8 : width );
+					if ( t < best ) best = t;
+				}
+				units = (double) ncodes;
+				nbytes = (double) ((ncodes * width + 7) / 8);
+				if ( op >= OP_PFPUTC ) nbytes = units = (double) ((ncodes * 8 + 7) / 8);
+				printf( "%-10s %5d %8u %10.3f %8.3f\n", op_names[ op ],
+					op >= OP_PFPUTC ? 8 : width, bufsize,
+					best * 1e9 / units, nbytes / best * 1e-9 );
+				fflush( stdout );
+			}
+		}
+	}
+	free( codes );
+	free( stream );
+	return 0;
+}
@@ -41,7 +41,7 @@ void init_put_buffer( void )
 			pBUFSIZE -= 1024;
 			if ( pBUFSIZE == 0 ) {
 				fprintf(stderr, "\nmemory allocation error!");
-				exit(0);
+				exit(1);
 			}
 		}
 	}
@@ -67,7 +67,7 @@ void init_get_buffer( void )
 			gBUFSIZE -= 1024;
 			if ( gBUFSIZE == 0 ) {
 				fprintf(stderr,"\nmemory allocation error!");
-				exit(0);
+				exit(1);
 			}
 		}
 	}
@@ -85,6 +85,7 @@ void free_get_buffer( void )
 {
 	gbuf = gbuf_start;
 	if ( gbuf ) free( gbuf );
+	gbuf = gbuf_start = gbuf_end = NULL;
 }
 
 void flush_put_buffer( void )
@@ -172,6 +173,50 @@ void pfputc( int c )
 	}
 }
 
+/* Reserves n contiguous bytes in the output buffer.
+
+	Returns a pointer to them; the caller may write the bytes in any
+	order (e.g., a string back to front) and then calls pfcommit()
+	with the number of bytes actually written. The buffer is flushed
+	first if the bytes do not fit, and it is enlarged if n > pBUFSIZE.
+	
+	Bytes past the committed ones are left undefined, so do not mix
+	pfreserve() with put_ONE(), put_ZERO() and put_nbits().
+*/
+unsigned char *pfreserve( unsigned int n )
+{
+	if ( pbuf_count + n > pBUFSIZE ) {
+		if ( pbuf_count ) {
+			fwrite( pbuf_start, pbuf_count, 1, pOUT );
+			nbytes_out += pbuf_count;
+			pbuf_count = 0;
+			pbuf = pbuf_start;
+		}
+		if ( n > pBUFSIZE ) {
+			pbuf = (unsigned char *) realloc( pbuf_start, n );
+			if ( !pbuf ) {
+				fprintf(stderr, "\nmemory allocation error!");
+				exit(1);
+			}
+			pbuf_start = pbuf;
+			pBUFSIZE = n;
+		}
+	}
+	return pbuf;
+}
+
+/* Commits n bytes written at the pointer returned by pfreserve(). */
+void pfcommit( unsigned int n )
+{
+	pbuf += n;
+	if ( (pbuf_count += n) == pBUFSIZE ){
+		fwrite( pbuf_start, pBUFSIZE, 1, pOUT );
+		nbytes_out += pBUFSIZE;
+		pbuf_count = 0;
+		pbuf = pbuf_start;
+	}
+}
+
 /* Multiple Bit Input/Output (2003/2004) */
 
 /* input more bits at a time; is faster. */
@@ -321,3 +366,9 @@ int64_t get_nbytes_read( void )
 	return ( nbytes_read + nfread );
 }
 /* nbytes_read = get_nbytes_read(); */
+
+/* the input bytes of the bits read so far (a partial byte counts). */
+int64_t get_nbytes_used( void )
+{
+	return ( nbytes_read + (gbuf - gbuf_start) + (g_cnt?1:0) );
+}
@@ -81,11 +81,14 @@ void flush_put_buffer( void );
 int  get_bit( void );
 int  gfgetc( void );
 void pfputc( int c );
+unsigned char *pfreserve( unsigned int n );
+void pfcommit( unsigned int n );
 unsigned int get_nbits( int size );
 void put_nbits( unsigned int k, int size );
 int get_symbol( int size );
 int64_t get_nbytes_out( void );
 int64_t get_nbytes_read( void );
+int64_t get_nbytes_used( void );
 
 #endif
 
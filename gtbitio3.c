@@ -41,7 +41,7 @@ void init_put_buffer( void )
 			pBUFSIZE -= 1024;
 			if ( pBUFSIZE == 0 ) {
 				fprintf(stderr, "\nmemory allocation error!");
-				exit(0);
+				exit(1);
 			}
 		}
 	}
@@ -67,11 +67,11 @@ void init_get_buffer( void )
 			gBUFSIZE -= 1024;
 			if ( gBUFSIZE == 0 ) {
 				fprintf(stderr,"\nmemory allocation error!");
-				exit(0);
+				exit(1);
 			}
 		}
 	}
-	nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+	nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 	gbuf_end = (unsigned char *) (gbuf + nfread);
 }
 
@@ -85,12 +85,13 @@ void free_get_buffer( void )
 {
 	gbuf = gbuf_start;
 	if ( gbuf ) free( gbuf );
+	gbuf = gbuf_start = gbuf_end = NULL;
 }
 
 void flush_put_buffer( void )
 {
 	if ( pbuf_count || p_cnt ) {
-		fwrite( pbuf_start, pbuf_count+(p_cnt?1:0), 1, pOUT );
+		gt_fwrite( pbuf_start, pbuf_count+(p_cnt?1:0), pOUT );
 		nbytes_out += (pbuf_count+(p_cnt?1:0));
 		pbuf = pbuf_start; pbuf_count = 0; p_cnt = 0;
 		memset( pbuf, 0, pBUFSIZE );
@@ -109,7 +110,7 @@ static inline int get_bit( void )
 				nbytes_read += nfread;
 				/* then fill buffer again. */
 				gbuf = gbuf_start;
-				nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+				nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 				gbuf_end = (unsigned char *) (gbuf + nfread);
 			}
 		}
@@ -151,7 +152,7 @@ static inline int gfgetc( void )
 		if ( gbuf == gbuf_end ) {
 			nbytes_read += nfread;
 			gbuf = gbuf_start;
-			nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+			nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 			gbuf_end = (unsigned char *) (gbuf + nfread);
 		}
 		return c;
@@ -164,7 +165,7 @@ static inline void pfputc( int c )
 {
 	*pbuf++ = (unsigned char) c;
 	if ( (++pbuf_count) == pBUFSIZE ){
-		fwrite( pbuf_start, pBUFSIZE, 1, pOUT );
+		gt_fwrite( pbuf_start, pBUFSIZE, pOUT );
 		nbytes_out += pBUFSIZE;
 		pbuf_count = 0;
 		pbuf = pbuf_start;
@@ -172,6 +173,50 @@ static inline void pfputc( int c )
 	}
 }
 
+/* Reserves n contiguous bytes in the output buffer.
+
+	Returns a pointer to them; the caller may write the bytes in any
+	order (e.g., a string back to front) and then calls pfcommit()
+	with the number of bytes actually written. The buffer is flushed
+	first if the bytes do not fit, and it is enlarged if n > pBUFSIZE.
+	
+	Bytes past the committed ones are left undefined, so do not mix
+	pfreserve() with put_ONE(), put_ZERO() and put_nbits().
+*/
+static inline unsigned char *pfreserve( unsigned int n )
+{
+	if ( pbuf_count + n > pBUFSIZE ) {
+		if ( pbuf_count ) {
+			gt_fwrite( pbuf_start, pbuf_count, pOUT );
+			nbytes_out += pbuf_count;
+			pbuf_count = 0;
+			pbuf = pbuf_start;
+		}
+		if ( n > pBUFSIZE ) {
+			pbuf = (unsigned char *) realloc( pbuf_start, n );
+			if ( !pbuf ) {
+				fprintf(stderr, "\nmemory allocation error!");
+				exit(1);
+			}
+			pbuf_start = pbuf;
+			pBUFSIZE = n;
+		}
+	}
+	return pbuf;
+}
+
+/* Commits n bytes written at the pointer returned by pfreserve(). */
+static inline void pfcommit( unsigned int n )
+{
+	pbuf += n;
+	if ( (pbuf_count += n) == pBUFSIZE ){
+		gt_fwrite( pbuf_start, pBUFSIZE, pOUT );
+		nbytes_out += pBUFSIZE;
+		pbuf_count = 0;
+		pbuf = pbuf_start;
+	}
+}
+
 /* Multiple Bit Input/Output (2003/2004) */
 
 /* input more bits at a time; is faster. */
@@ -187,7 +232,7 @@ static inline unsigned int get_nbits( int size )
 			nbytes_read += nfread;
 			/* then fill buffer again. */
 			gbuf = gbuf_start;
-			nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+			nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 			gbuf_end = (unsigned char *) (gbuf + nfread);
 		}
 		
@@ -199,7 +244,7 @@ static inline unsigned int get_nbits( int size )
 				if ( (++gbuf) == gbuf_end ) {
 					nbytes_read += nfread;
 					gbuf = gbuf_start;
-					nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+					nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 					gbuf_end = (unsigned char *) (gbuf + nfread);
 				}
 			}
@@ -223,7 +268,7 @@ static inline void put_nbits( unsigned int k, int size )
 		k >>= (8-p_cnt);
 		p_cnt = 0;
 		if ( (++pbuf_count) == pBUFSIZE ){
-			fwrite( pbuf_start, pBUFSIZE, 1, pOUT );
+			gt_fwrite( pbuf_start, pBUFSIZE, pOUT );
 			nbytes_out += pBUFSIZE;
 			pbuf_count = 0;
 			pbuf = pbuf_start;
@@ -237,7 +282,7 @@ static inline void put_nbits( unsigned int k, int size )
 				size -= 8;
 				k >>= 8;
 				if ( (++pbuf_count) == pBUFSIZE ){
-					fwrite( pbuf_start, pBUFSIZE, 1, pOUT );
+					gt_fwrite( pbuf_start, pBUFSIZE, pOUT );
 					nbytes_out += pBUFSIZE;
 					pbuf_count = 0;
 					pbuf = pbuf_start;
@@ -269,7 +314,7 @@ static inline int get_symbol( int size )
 		if ( (++gbuf) == gbuf_end ) { /* end of buffer? */
 			nbytes_read += nfread;
 			gbuf = gbuf_start;
-			nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+			nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 			gbuf_end = (unsigned char *) (gbuf + nfread);
 			/* we still have some bits to read but no more bits
 				from the file; return end-of-file.
@@ -290,7 +335,7 @@ static inline int get_symbol( int size )
 				if ( (++gbuf) == gbuf_end ) {
 					nbytes_read += nfread;
 					gbuf = gbuf_start;
-					nfread = fread ( gbuf, 1, gBUFSIZE, gIN );
+					nfread = gt_fread( gbuf, gBUFSIZE, gIN );
 					gbuf_end = (unsigned char *) (gbuf + nfread);
 					if ( size > 0 && nfread == 0 ) {
 						/* store the actual bits read. */
@@ -321,3 +366,9 @@ int64_t get_nbytes_read( void )
 	return ( nbytes_read + nfread );
 }
 /* nbytes_read = get_nbytes_read(); */
+
+/* the input bytes of the bits read so far (a partial byte counts). */
+int64_t get_nbytes_used( void )
+{
+	return ( nbytes_read + (gbuf - gbuf_start) + (g_cnt?1:0) );
+}
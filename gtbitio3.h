@@ -26,6 +26,17 @@ number of bits.
 	#endif
 #endif
 
+/*
+	The calls that move whole buffers to and from the files. A program
+	may define them before including gtbitio3.c, e.g. to time the I/O.
+*/
+#if !defined( gt_fread )
+	#define gt_fread( p, n, fp )   fread( (p), 1, (n), (fp) )
+#endif
+#if !defined( gt_fwrite )
+	#define gt_fwrite( p, n, fp )  fwrite( (p), (n), 1, (fp) )
+#endif
+
 #define pset_bit() *pbuf |= (1<<p_cnt)
 
 /* ---- writes a ONE (1) bit. ---- */
@@ -41,7 +52,7 @@ number of bits.
 		p_cnt = 0; \
 		if ( (++pbuf_count) == pBUFSIZE ){ \
 			pbuf = pbuf_start; \
-			fwrite( pbuf, pBUFSIZE, 1, pOUT ); \
+			gt_fwrite( pbuf, pBUFSIZE, pOUT ); \
 			memset( pbuf, 0, pBUFSIZE ); \
 			pbuf_count = 0; \
 			nbytes_out += pBUFSIZE; \
@@ -58,7 +69,7 @@ number of bits.
 		if ( ++gbuf == gbuf_end ) {   \
 			nbytes_read += nfread;   \
 			gbuf = gbuf_start;   \
-			nfread = fread ( gbuf, 1, gBUFSIZE, gIN );   \
+			nfread = gt_fread( gbuf, gBUFSIZE, gIN );   \
 			gbuf_end = (unsigned char *) (gbuf + nfread);   \
 		}   \
 	}   \
@@ -81,10 +92,13 @@ void flush_put_buffer( void );
 static inline int  get_bit( void );
 static inline int  gfgetc( void );
 static inline void pfputc( int c );
+static inline unsigned char *pfreserve( unsigned int n );
+static inline void pfcommit( unsigned int n );
 static inline unsigned int get_nbits( int size );
 static inline void put_nbits( unsigned int k, int size );
 static inline int get_symbol( int size );
 int64_t get_nbytes_out( void );
 int64_t get_nbytes_read( void );
+int64_t get_nbytes_used( void );
 
 #endif
@@ -0,0 +1,203 @@
+/*
+	Filename:  LZWAUTO.C
+	
+	The choice of the code size and the reset policy of lzwhc --auto.
+	
+	AUTO_SLICES slices spread over the input are read into memory and
+	compressed with every candidate setting: code sizes 12, 14, ...,
+	each with blind resets and in the CLEAR mode. The trial runs (one
+	per setting and slice) are shared by the threads; each one is
+	timed, and its output is counted in bits, not packed. The setting
+	that best fits the objective is then picked.
+	
+	A table bigger than a slice can fill up would be judged on its
+	cheap first codes only, so such code sizes are not candidates
+	(but 16 always is); larger inputs get larger samples, and larger
+	code sizes. The speed of a setting is that of its fastest slice,
+	as the first one also pays for touching the new tables.
+	
+	Needs POSIX threads (link with -lpthread).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <pthread.h>
+#include <unistd.h>
+#include "lzwenc.h"
+#include "lzwrun.h"
+#include "lzwtrace.h"
+#include "lzwmax.h"
+#include "lzwauto.h"
+
+#define AUTO_NCODES   (1<<16)
+#define AUTO_MAXCAND  (2*(28-12+1))
+
+/* the trial runs shared by the threads. */
+static struct {
+	unsigned char *slice[ AUTO_SLICES ];
+	int64_t slice_size;
+	int ncand;
+	int cand_bits[ AUTO_MAXCAND ], cand_clear[ AUTO_MAXCAND ];
+	int64_t bits[ AUTO_MAXCAND ][ AUTO_SLICES ];
+	double secs[ AUTO_MAXCAND ][ AUTO_SLICES ];
+	int next_task;
+	int failed;
+} trial;
+
+/* the candidates up to top: code sizes 12, 14, ... and top. */
+static int auto_candidates( int top )
+{
+	int n, k, ncand = 0;
+	
+	for ( n = 12; n <= top; n++ ) {
+		if ( (n & 1) && n != top ) continue;
+		for ( k = 0; k <= 1; k++ ) {
+			trial.cand_bits[ ncand ] = n;
+			trial.cand_clear[ ncand++ ] = k;
+		}
+	}
+	return ncand;
+}
+
+static void *auto_thread( void *arg )
+{
+	uint32_t *out;
+	const unsigned char *p, *end;
+	lzw_dict d;
+	int t, c, s, cur = -1, width;
+	int64_t bits;
+	double t0;
+	size_t n;
+	
+	(void) arg;
+	max_worker = 1;
+	trace_thread_name( "auto" );
+	memset( &d, 0, sizeof(d) );
+	if ( (out = (uint32_t *) malloc( sizeof(uint32_t) * AUTO_NCODES )) == NULL ) {
+		trial.failed = 1;
+		return NULL;
+	}
+	while ( (t = __atomic_fetch_add( &trial.next_task, 1, __ATOMIC_RELAXED ))
+			< trial.ncand * AUTO_SLICES ) {
+		c = t / AUTO_SLICES;
+		s = t % AUTO_SLICES;
+		if ( c != cur ) {
+			lzw_dict_free( &d );
+			if ( !lzw_dict_alloc( &d, trial.cand_bits[ c ] ) ) {
+				trial.failed = 1;
+				break;
+			}
+			if ( trial.cand_clear[ c ] ) lzw_dict_use_clear( &d );
+			cur = c;
+		}
+		TRACE_BEGIN( "trial" );
+		t0 = wall_time();
+		lzw_dict_init( &d );
+		p = trial.slice[ s ];
+		end = p + trial.slice_size;
+		bits = 0;
+		width = d.bit_count;
+		while ( p < end ) {
+			n = lzw_match( &d, &p, end, out, AUTO_NCODES );
+			bits += lzw_count_bits( out, n, &width );
+		}
+		n = lzw_match_end( &d, out );
+		bits += lzw_count_bits( out, n, &width );
+		trial.secs[ c ][ s ] = wall_time() - t0;
+		trial.bits[ c ][ s ] = bits;
+		TRACE_END( "trial" );
+	}
+	lzw_dict_free( &d );
+	free( out );
+	return NULL;
+}
+
+int64_t auto_tune( FILE *fp, int64_t size, int max_bits, int objective,
+	int nthreads, auto_setting *best )
+{
+	pthread_t threads[ 256 ];
+	auto_setting set[ AUTO_MAXCAND ];
+	int64_t sample = 0, bits, at, ok = 0;
+	double speed, fastest = 0;
+	int i, c, s, top, better;
+	
+	memset( &trial, 0, sizeof(trial) );
+	if ( nthreads <= 0 ) nthreads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+	if ( nthreads <= 0 ) nthreads = 1;
+	if ( nthreads > 256 ) nthreads = 256;
+	
+	/* the largest code size whose table fills up in a slice of its sample. */
+	for ( top = max_bits; ; top-- ) {
+		trial.ncand = auto_candidates( top );
+		sample = (int64_t) (size * AUTO_BUDGET * nthreads / trial.ncand);
+		if ( sample < AUTO_MIN_SAMPLE ) sample = AUTO_MIN_SAMPLE;
+		if ( sample > AUTO_MAX_SAMPLE ) sample = AUTO_MAX_SAMPLE;
+		if ( sample > size ) sample = size;
+		if ( (4 << top) <= sample / AUTO_SLICES || top <= 16 ) break;
+	}
+	trial.slice_size = sample / AUTO_SLICES;
+	if ( trial.slice_size == 0 ) trial.slice_size = size;
+	
+	/* read the slices, at the middle of each AUTO_SLICES-th of the input. */
+	for ( s = 0; s < AUTO_SLICES; s++ ) {
+		trial.slice[ s ] = (unsigned char *) malloc( trial.slice_size );
+		if ( !trial.slice[ s ] ) goto done;
+		at = size * (2*s+1) / (2*AUTO_SLICES) - trial.slice_size / 2;
+		if ( at + trial.slice_size > size ) at = size - trial.slice_size;
+		if ( at < 0 ) at = 0;
+		fseek( fp, (long) at, SEEK_SET );
+		if ( fread( trial.slice[ s ], 1, trial.slice_size, fp ) != (size_t) trial.slice_size ) goto done;
+	}
+	
+	/* the trial runs. */
+	for ( i = 0; i < nthreads; i++ ) {
+		if ( pthread_create( &threads[ i ], NULL, auto_thread, NULL ) != 0 ) break;
+	}
+	if ( i == 0 ) auto_thread( NULL );
+	nthreads = i;
+	for ( i = 0; i < nthreads; i++ ) pthread_join( threads[ i ], NULL );
+	max_worker = 0;
+	if ( trial.failed ) goto done;
+	
+	for ( c = 0; c < trial.ncand; c++ ) {
+		bits = 0;
+		set[ c ].mb_per_s = 0;
+		for ( s = 0; s < AUTO_SLICES; s++ ) {
+			bits += trial.bits[ c ][ s ];
+			speed = trial.secs[ c ][ s ] > 0 ?
+				trial.slice_size / 1048576.0 / trial.secs[ c ][ s ] : 1e9;
+			if ( speed > set[ c ].mb_per_s ) set[ c ].mb_per_s = speed;
+		}
+		set[ c ].code_max_bits = trial.cand_bits[ c ];
+		set[ c ].clear = trial.cand_clear[ c ];
+		set[ c ].ratio = bits / (8.0 * trial.slice_size * AUTO_SLICES);
+		if ( set[ c ].mb_per_s > fastest ) fastest = set[ c ].mb_per_s;
+	}
+	
+	/* the pick. */
+	*best = set[ 0 ];
+	for ( c = 1; c < trial.ncand; c++ ) {
+		switch ( objective ) {
+			case AUTO_SPEED:
+				better = set[ c ].mb_per_s > best->mb_per_s;
+				break;
+			case AUTO_RATIO:
+				better = set[ c ].ratio < best->ratio;
+				break;
+			default:
+				if ( set[ c ].mb_per_s < AUTO_MIN_SPEED * fastest ) better = 0;
+				else better = best->mb_per_s < AUTO_MIN_SPEED * fastest
+					|| set[ c ].ratio < best->ratio;
+		}
+		if ( better ) *best = set[ c ];
+	}
+	ok = trial.slice_size * AUTO_SLICES;
+	
+	done:
+	for ( s = 0; s < AUTO_SLICES; s++ ) {
+		if ( trial.slice[ s ] ) free( trial.slice[ s ] );
+	}
+	rewind( fp );
+	return ok;
+}
@@ -0,0 +1,49 @@
+/* LZWAUTO.H, the choice of the code size and reset policy of LZWHC from a sample, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWAUTO_H )
+	#define LZWAUTO_H
+
+/* the objectives of --auto. */
+enum {
+	AUTO_BALANCED,   /* smallest output at AUTO_MIN_SPEED of the fastest setting or better. */
+	AUTO_RATIO,      /* smallest output. */
+	AUTO_SPEED       /* fastest compression. */
+};
+
+#define AUTO_MIN_SPEED     0.67
+
+/*
+	The sample is cut into AUTO_SLICES slices spread over the input.
+	Every setting compresses the whole sample, so the sample size is
+	chosen to keep the work of all the settings, shared by the threads,
+	near AUTO_BUDGET of the work of compressing the input once; but at
+	least AUTO_MIN_SAMPLE bytes, in which a 16-bit table (the default)
+	fills up, and at most AUTO_MAX_SAMPLE. For inputs under a few
+	hundred MB per thread, the minimum costs more than AUTO_BUDGET.
+*/
+#define AUTO_SLICES        2
+#define AUTO_BUDGET        0.03
+#define AUTO_MIN_SAMPLE    (512<<10)
+#define AUTO_MAX_SAMPLE    (32<<20)
+
+typedef struct {
+	int code_max_bits;
+	int clear;               /* 1 = the CLEAR mode, 0 = blind resets. */
+	double ratio;            /* output/input of the sample. */
+	double mb_per_s;         /* compression speed, the best of the slices. */
+} auto_setting;
+
+/*
+	Compresses a sample of fp (size bytes) with code sizes 12, 14, ...
+	up to max_bits, each with blind resets and in the CLEAR mode, on
+	nthreads threads (0 = one per processor); code sizes above 16 whose
+	table cannot fill up in a slice are skipped. Stores the best setting for
+	the objective in *best and returns the sample size, or 0 on error.
+	fp is left at the start.
+*/
+int64_t auto_tune( FILE *fp, int64_t size, int max_bits, int objective,
+	int nthreads, auto_setting *best );
+
+#endif
@@ -0,0 +1,482 @@
+/*
+	---- LZWBENCH.C, an end-to-end benchmark of the LZW codecs ----
+
+	Generates deterministic local test files (text-like, log-like,
+	binary records, random, long runs, sorted bytes), runs every codec
+	of this archive on them at several settings, checks the round
+	trip, and reports wall-clock MB/s for compression and
+	decompression, the compression ratio and the peak RSS.
+	Results are written as CSV and JSON for tracking over time.
+	
+	Each compressed file is also given to its decoder (and to its -t
+	test, if any) with the code size byte of the header made out of
+	range: the decoder must reject it with a nonzero exit, not crash.
+	The exit status is 1 if a codec fails either check.
+
+	Usage:
+
+		lzwbench [-b bindir] [-s MB] [-r N] [-o name] [-w dir] [-k]
+
+	  -b bindir = directory of the codec executables (default=.)
+	  -s MB     = size of each test file in MB (default=4)
+	  -r N      = runs per measurement; the fastest is reported (default=3)
+	  -o name   = results go to name.csv and name.json (default=lzwbench)
+	  -w dir    = work directory (default=a new directory in /tmp)
+	  -k        = keep the test files
+
+	Codecs not found in bindir are skipped. POSIX only (fork/exec/wait4).
+
+	Build: gcc -O2 -o lzwbench lzwbench.c
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+typedef struct {
+	const char *name;       /* name in the results. */
+	const char *encoder;    /* executables. */
+	const char *decoder;
+	const char *copt[3];    /* compression options (NULL-terminated). */
+	const char *dopt;       /* decompression option, or NULL. */
+	const char *topt;       /* test option (decoder topt infile), or NULL. */
+} bench_codec;
+
+static const bench_codec codecs[] = {
+	{ "lzwh",  "lzwh",  "lzwhd",  { "-12", NULL },          NULL, "-t" },
+	{ "lzwh",  "lzwh",  "lzwhd",  { "-16", NULL },          NULL, "-t" },
+	{ "lzwgt", "lzwgt", "lzwgtd", { "-12", NULL },          NULL, NULL },
+	{ "lzwg",  "lzwg",  "lzwgd",  { "-12", NULL },          NULL, NULL },
+	{ "lzwg",  "lzwg",  "lzwgd",  { "-16", NULL },          NULL, NULL },
+	{ "lzwg",  "lzwg",  "lzwgd",  { "-20", NULL },          NULL, NULL },
+	{ "lzwhc", "lzwhc", "lzwhc",  { "-c12", NULL },         "-d", "-t" },
+	{ "lzwhc", "lzwhc", "lzwhc",  { "-c16", NULL },         "-d", "-t" },
+	{ "lzwhc", "lzwhc", "lzwhc",  { "-c20", NULL },         "-d", "-t" },
+	{ "lzwz",  "lzwz",  "lzwz",   { "-c16", NULL },         "-d", NULL },
+	{ "lzwz",  "lzwz",  "lzwz",   { "-c16", "-nr", NULL },  "-d", NULL },
+	{ "lzwz2", "lzwz2", "lzwz2",  { "-c20", NULL },         "-d", NULL },
+	{ "lzwz2", "lzwz2", "lzwz2",  { "-c20", "-nr", NULL },  "-d", NULL },
+};
+#define NCODECS (int)(sizeof(codecs)/sizeof(codecs[0]))
+
+/* ---- deterministic test data ---- */
+
+static uint64_t rng_state;
+
+/* xorshift64* */
+static uint64_t rng( void )
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* 0 <= r < n, skewed toward 0 (about Zipf-like). */
+static unsigned skewed( unsigned n )
+{
+	double u = (double) (rng() >> 11) / 9007199254740992.0;
+	return (unsigned) (n * u * u * u);
+}
+
+static const char *syllables[] = {
+	"ka", "lo", "ri", "ne", "ta", "mu", "si", "pe", "do", "ga",
+	"ber", "ton", "lin", "mar", "sen", "val", "dor", "pri", "con", "est"
+};
+
+static void gen_text( unsigned char *p, size_t size )
+{
+	char words[ 2048 ][ 16 ];
+	size_t n = 0;
+	int i, j, k, col = 0, first = 1;
+
+	for ( i = 0; i < 2048; i++ ) {
+		k = 1 + (int) (rng() % 4);
+		words[ i ][ 0 ] = 0;
+		for ( j = 0; j < k; j++ ) strcat( words[ i ], syllables[ rng() % 20 ] );
+	}
+	while ( n < size ) {
+		const char *w = words[ skewed( 2048 ) ];
+
+		for ( i = 0; w[ i ] && n < size; i++ )
+			p[ n++ ] = (first && i == 0) ? (w[ i ] - 'a' + 'A') : w[ i ];
+		col += i + 1;
+		first = 0;
+		if ( n < size ) {
+			if ( rng() % 12 == 0 ) {
+				p[ n++ ] = '.';
+				first = 1;
+			}
+			else if ( rng() % 9 == 0 ) p[ n++ ] = ',';
+		}
+		if ( n < size ) {
+			if ( col > 70 ) { p[ n++ ] = '\n'; col = 0; }
+			else p[ n++ ] = ' ';
+		}
+	}
+}
+
+static void gen_log( unsigned char *p, size_t size )
+{
+	static const char *levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+	static const char *paths[] = { "/api/v1/users", "/api/v1/orders", "/static/app.js",
+		"/health", "/api/v2/search", "/login" };
+	char line[ 256 ];
+	size_t n = 0, len;
+	unsigned long t = 1700000000UL, ms = 0;
+
+	while ( n < size ) {
+		ms += rng() % 250;
+		if ( ms >= 1000 ) { t += ms / 1000; ms %= 1000; }
+		len = (size_t) sprintf( line,
+			"%lu.%03lu host-%02u app[%u]: %s request id=%08x path=%s/%u status=%u bytes=%u ms=%u\n",
+			t, ms, (unsigned) (rng() % 8), 1000 + (unsigned) (rng() % 4),
+			levels[ rng() % 6 ], (unsigned) rng(), paths[ skewed( 6 ) ],
+			skewed( 5000 ), (rng() % 10) ? 200 : 404, (unsigned) (rng() % 65536),
+			skewed( 900 ) );
+		if ( len > size - n ) len = size - n;
+		memcpy( p + n, line, len );
+		n += len;
+	}
+}
+
+/* fixed-size little-endian records of slowly changing values. */
+static void gen_binary( unsigned char *p, size_t size )
+{
+	uint32_t id = 0, t = 1700000000u;
+	int v[ 4 ] = { 1000, 2000, -500, 0 }, i;
+	size_t n = 0;
+	unsigned char rec[ 16 ];
+
+	while ( n < size ) {
+		id++;
+		t += 1 + (uint32_t) (rng() % 3);
+		for ( i = 0; i < 4; i++ ) v[ i ] += (int) (rng() % 7) - 3;
+		for ( i = 0; i < 4; i++ ) {
+			rec[ i ] = (unsigned char) (id >> (8*i));
+			rec[ 4+i ] = (unsigned char) (t >> (8*i));
+		}
+		for ( i = 0; i < 4; i++ ) {
+			rec[ 8+2*i ] = (unsigned char) v[ i ];
+			rec[ 9+2*i ] = (unsigned char) (v[ i ] >> 8);
+		}
+		for ( i = 0; i < 16 && n < size; i++ ) p[ n++ ] = rec[ i ];
+	}
+}
+
+static void gen_random( unsigned char *p, size_t size )
+{
+	size_t n;
+
+	for ( n = 0; n < size; n++ ) p[ n ] = (unsigned char) (rng() >> 56);
+}
+
+/* runs of 1 byte to 64K, a third of them zeros. */
+static void gen_runs( unsigned char *p, size_t size )
+{
+	size_t n = 0, len;
+	int c;
+
+	while ( n < size ) {
+		len = 1 + skewed( 65536 );
+		c = (rng() % 3) ? (int) (rng() >> 56) : 0;
+		if ( len > size - n ) len = size - n;
+		memset( p + n, c, len );
+		n += len;
+	}
+}
+
+static void gen_sorted( unsigned char *p, size_t size )
+{
+	size_t count[ 256 ] = { 0 }, n;
+	int c;
+
+	for ( n = 0; n < size; n++ ) count[ rng() >> 56 ]++;
+	for ( c = 0, n = 0; c < 256; c++ ) {
+		memset( p + n, c, count[ c ] );
+		n += count[ c ];
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*gen)( unsigned char *p, size_t size );
+} corpora[] = {
+	{ "text",   gen_text   },
+	{ "log",    gen_log    },
+	{ "binary", gen_binary },
+	{ "random", gen_random },
+	{ "runs",   gen_runs   },
+	{ "sorted", gen_sorted },
+};
+#define NCORPORA (int)(sizeof(corpora)/sizeof(corpora[0]))
+
+/* ---- running the codecs ---- */
+
+static double now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+	Runs argv[] with stdout and stderr discarded. Returns 0 on success,
+	1 on a nonzero exit, 2 if killed by a signal (-1 if it cannot run),
+	the wall-clock time in *secs and the peak RSS in KB in *rss.
+*/
+static int run( char *const argv[], double *secs, long *rss )
+{
+	struct rusage ru;
+	double t0 = now();
+	int status, fd;
+	pid_t pid = fork();
+
+	if ( pid < 0 ) return -1;
+	if ( pid == 0 ) {
+		fd = open( "/dev/null", O_WRONLY );
+		if ( fd >= 0 ) {
+			dup2( fd, 1 );
+			dup2( fd, 2 );
+		}
+		execv( argv[0], argv );
+		_exit( 127 );
+	}
+	if ( wait4( pid, &status, 0, &ru ) < 0 ) return -1;
+	*secs = now() - t0;
+	*rss = ru.ru_maxrss;
+	if ( !WIFEXITED(status) ) return 2;
+	return WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+static int64_t file_size( const char *name )
+{
+	struct stat st;
+
+	return stat( name, &st ) == 0 ? (int64_t) st.st_size : -1;
+}
+
+static int same_file( const char *a, const char *b )
+{
+	FILE *fa = fopen( a, "rb" ), *fb = fopen( b, "rb" );
+	static unsigned char ba[ 1<<16 ], bb[ 1<<16 ];
+	size_t na, nb;
+	int same = (fa && fb);
+
+	while ( same ) {
+		na = fread( ba, 1, sizeof(ba), fa );
+		nb = fread( bb, 1, sizeof(bb), fb );
+		if ( na != nb || memcmp( ba, bb, na ) ) same = 0;
+		if ( na == 0 ) break;
+	}
+	if ( fa ) fclose( fa );
+	if ( fb ) fclose( fb );
+	return same;
+}
+
+/*
+	Writes z to bad with the code size byte of the header (byte 7, see
+	LZWHDR.H) out of range, and decodes it with c: returns 1 if the
+	decoder, and its -t test if any, exit nonzero without a signal.
+*/
+static int rejects_bad_header( const bench_codec *c, const char *dec,
+	const char *z, const char *bad, const char *out )
+{
+	static unsigned char b[ 1<<16 ];
+	FILE *fi = fopen( z, "rb" ), *fo = fopen( bad, "wb" );
+	char *args[ 6 ];
+	size_t n, at = 0;
+	double t;
+	long rss;
+	int ok = (fi && fo), a = 0;
+	
+	while ( ok && (n = fread( b, 1, sizeof(b), fi )) > 0 ) {
+		if ( at == 0 && n > 7 ) b[ 7 ] ^= 0x80;
+		at += n;
+		if ( fwrite( b, 1, n, fo ) != n ) ok = 0;
+	}
+	if ( fi ) fclose( fi );
+	if ( fo ) fclose( fo );
+	if ( at < 8 ) ok = 0;
+	
+	args[ a++ ] = (char *) dec;
+	if ( c->dopt ) args[ a++ ] = (char *) c->dopt;
+	args[ a++ ] = (char *) bad;
+	args[ a++ ] = (char *) out;
+	args[ a ] = NULL;
+	if ( ok && run( args, &t, &rss ) != 1 ) ok = 0;
+	if ( ok && c->topt ) {
+		args[ 1 ] = (char *) c->topt;
+		args[ 2 ] = (char *) bad;
+		args[ 3 ] = NULL;
+		if ( run( args, &t, &rss ) != 1 ) ok = 0;
+	}
+	remove( bad );
+	return ok;
+}
+
+void usage( void )
+{
+	fprintf(stderr, "\n Usage: lzwbench [-b bindir] [-s MB] [-r N] [-o name] [-w dir] [-k]\n");
+	exit (0);
+}
+
+int main( int argc, char *argv[] )
+{
+	const char *bindir = ".", *outname = "lzwbench";
+	char workdir[ 256 ] = "", enc[ 512 ], dec[ 512 ], in[ 400 ], z[ 512 ], out[ 512 ], bad[ 512 ];
+	char fname[ 512 ], opts[ 64 ];
+	char *args[ 8 ];
+	size_t size = 4 << 20;
+	int runs = 3, keep = 0, i, k, r, a, first = 1, ok, hdr_ok, failures = 0;
+	double ct, dt, t, ratio;
+	long crss, drss, rss;
+	int64_t zsize;
+	unsigned char *buf;
+	FILE *fp, *csv, *json;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 ) usage();
+		if ( argv[i][1] == 'k' ) {
+			keep = 1;
+			continue;
+		}
+		if ( i+1 == argc ) usage();
+		switch ( argv[i++][1] ) {
+			case 'b': bindir = argv[i]; break;
+			case 's': size = (size_t) atoi( argv[i] ) << 20; break;
+			case 'r': runs = atoi( argv[i] ); break;
+			case 'o': outname = argv[i]; break;
+			case 'w': snprintf( workdir, sizeof(workdir), "%s", argv[i] ); break;
+			default: usage();
+		}
+	}
+	if ( size == 0 || runs < 1 ) usage();
+
+	if ( workdir[0] == 0 ) {
+		strcpy( workdir, "/tmp/lzwbench.XXXXXX" );
+		if ( !mkdtemp( workdir ) ) {
+			fprintf(stderr, "\nError creating work directory.");
+			return 1;
+		}
+	}
+	else mkdir( workdir, 0755 );
+
+	snprintf( fname, sizeof(fname), "%s.csv", outname );
+	csv = fopen( fname, "w" );
+	snprintf( fname, sizeof(fname), "%s.json", outname );
+	json = fopen( fname, "w" );
+	if ( !csv || !json ) {
+		fprintf(stderr, "\nError opening output files %s.csv/.json.", outname );
+		return 1;
+	}
+	fprintf( csv, "corpus,codec,options,in_bytes,out_bytes,ratio,"
+		"comp_mbs,decomp_mbs,comp_rss_kb,decomp_rss_kb,ok\n" );
+	fprintf( json, "[\n" );
+
+	buf = (unsigned char *) malloc( size );
+	if ( !buf ) {
+		fprintf(stderr, "\nError alloc: test buffer.");
+		return 1;
+	}
+
+	printf( "%-7s %-6s %-10s %11s %7s %9s %9s %8s %8s\n", "corpus", "codec", "options",
+		"out bytes", "ratio%", "comp MB/s", "dec MB/s", "comp RSS", "dec RSS" );
+
+	for ( k = 0; k < NCORPORA; k++ ) {
+		/* the same seed always gives the same file. */
+		rng_state = 0x9E3779B97F4A7C15ULL + (uint64_t) k;
+		corpora[ k ].gen( buf, size );
+		snprintf( in, sizeof(in), "%s/%s", workdir, corpora[ k ].name );
+		fp = fopen( in, "wb" );
+		if ( !fp || fwrite( buf, 1, size, fp ) != size ) {
+			fprintf(stderr, "\nError writing %s.", in );
+			return 1;
+		}
+		fclose( fp );
+		snprintf( z, sizeof(z), "%s.lzw", in );
+		snprintf( out, sizeof(out), "%s.out", in );
+		snprintf( bad, sizeof(bad), "%s.bad", in );
+
+		for ( i = 0; i < NCODECS; i++ ) {
+			snprintf( enc, sizeof(enc), "%s/%s", bindir, codecs[ i ].encoder );
+			snprintf( dec, sizeof(dec), "%s/%s", bindir, codecs[ i ].decoder );
+			if ( access( enc, X_OK ) || access( dec, X_OK ) ) continue;
+
+			opts[ 0 ] = 0;
+			for ( a = 0; codecs[ i ].copt[ a ]; a++ ) {
+				if ( a ) strcat( opts, " " );
+				strcat( opts, codecs[ i ].copt[ a ] );
+			}
+
+			ct = dt = 1e30; crss = drss = 0; ok = 1;
+			for ( r = 0; r < runs && ok; r++ ) {
+				/* compress. */
+				args[ 0 ] = enc;
+				for ( a = 1; codecs[ i ].copt[ a-1 ]; a++ ) args[ a ] = (char *) codecs[ i ].copt[ a-1 ];
+				args[ a++ ] = in;
+				args[ a++ ] = z;
+				args[ a ] = NULL;
+				if ( run( args, &t, &rss ) ) ok = 0;
+				if ( t < ct ) ct = t;
+				if ( rss > crss ) crss = rss;
+
+				/* decompress. */
+				a = 0;
+				args[ a++ ] = dec;
+				if ( codecs[ i ].dopt ) args[ a++ ] = (char *) codecs[ i ].dopt;
+				args[ a++ ] = z;
+				args[ a++ ] = out;
+				args[ a ] = NULL;
+				if ( run( args, &t, &rss ) ) ok = 0;
+				if ( t < dt ) dt = t;
+				if ( rss > drss ) drss = rss;
+			}
+			if ( ok ) ok = same_file( in, out );
+			zsize = file_size( z );
+			hdr_ok = rejects_bad_header( &codecs[ i ], dec, z, bad, out );
+			ratio = 100.0 * ((double) size - zsize) / size;
+
+			printf( "%-7s %-6s %-10s %11lld %7.2f %9.2f %9.2f %8ld %8ld%s%s\n",
+				corpora[ k ].name, codecs[ i ].name, opts, (long long) zsize, ratio,
+				size / 1048576.0 / ct, size / 1048576.0 / dt, crss, drss,
+				ok ? "" : "  FAILED", hdr_ok ? "" : "  BAD HEADER ACCEPTED" );
+			fflush( stdout );
+			if ( !hdr_ok ) ok = 0;
+			if ( !ok ) failures++;
+
+			fprintf( csv, "%s,%s,%s,%lu,%lld,%.4f,%.3f,%.3f,%ld,%ld,%d\n",
+				corpora[ k ].name, codecs[ i ].name, opts, (unsigned long) size,
+				(long long) zsize, ratio, size / 1048576.0 / ct,
+				size / 1048576.0 / dt, crss, drss, ok );
+			fprintf( json, "%s  {\"corpus\":\"%s\",\"codec\":\"%s\",\"options\":\"%s\","
+				"\"in_bytes\":%lu,\"out_bytes\":%lld,\"ratio\":%.4f,\"comp_mbs\":%.3f,"
+				"\"decomp_mbs\":%.3f,\"comp_rss_kb\":%ld,\"decomp_rss_kb\":%ld,\"ok\":%s}",
+				first ? "" : ",\n", corpora[ k ].name, codecs[ i ].name, opts,
+				(unsigned long) size, (long long) zsize, ratio,
+				size / 1048576.0 / ct, size / 1048576.0 / dt, crss, drss,
+				ok ? "true" : "false" );
+			first = 0;
+			remove( z );
+			remove( out );
+		}
+		if ( !keep ) remove( in );
+	}
+	fprintf( json, "\n]\n" );
+	fclose( csv );
+	fclose( json );
+	free( buf );
+	if ( !keep ) rmdir( workdir );
+	printf( "\nResults: %s.csv, %s.json\n", outname, outname );
+	return failures != 0;
+}
@@ -18,6 +18,9 @@ unsigned char  *code_char;
 /* code_prefix[i] = prefix of code i */
 unsigned int   *code_prefix = NULL;
 
+/* code_len[i] = length of the string of code i */
+unsigned int   *code_len = NULL;
+
 /* ---- the Binary-Tree data structure ---- */
 
 /* bt_code[i] = first LZW code with prefix i */
@@ -59,6 +62,11 @@ int alloc_code_tables ( unsigned int size, int lzw_mode )
 			fprintf( stderr, "\n error alloc: code_prefix.");
 			return 0;
 		}
+		code_len = (unsigned int *) calloc( size, sizeof(int) );
+		if ( !code_len ) {
+			fprintf( stderr, "\n error alloc: code_len.");
+			return 0;
+		}
 	}
 	
 	return 1;
@@ -80,6 +88,7 @@ void init_code_tables ( unsigned int size, int lzw_mode )
 	if ( lzw_mode == LZW_DECOMPRESS ){
 		for ( i = 0; i < size; i++ ) {
 			code_prefix[ i ] = LZW_NULL;
+			code_len[ i ] = 1;
 		}
 	}
 }
@@ -90,6 +99,10 @@ void free_code_tables( void )
 	if ( left ) free( left );
 	if ( right ) free( right );
 	if ( code_prefix ) free( code_prefix );
+	if ( code_len ) free( code_len );
+	if ( code_char ) free( code_char );
+	bt_code = left = right = code_prefix = code_len = NULL;
+	code_char = NULL;
 }
 
 /* Binary-tree search. */
@@ -145,5 +158,6 @@ int lzw_decomp_insert( unsigned int prefix, unsigned char c )
 {
 	code_prefix  [ lzw_code_cnt ] = prefix;
 	code_char    [ lzw_code_cnt ] = c;
+	code_len     [ lzw_code_cnt ] = code_len[ prefix ] + 1;
 	return 1;
 }
@@ -13,6 +13,7 @@
 
 extern unsigned char    *code_char;
 extern unsigned int     *code_prefix;
+extern unsigned int     *code_len;
 
 extern unsigned int     *bt_code;
 extern unsigned int     *left;
@@ -0,0 +1,189 @@
+/*
+	Filename:  LZWCRC.C
+	
+	The CRC32C checksums of lzwhc. On x86-64 processors with SSE4.2
+	(checked at run time) the CRC32 instruction takes 8 bytes at a
+	time; it has a latency of 3 cycles and a throughput of 1, so a
+	buffer is cut into three lanes whose CRCs are computed together
+	and then combined. Elsewhere, a table of 8 x 256 words takes
+	8 bytes per step (slicing-by-8).
+	
+	The CRCs are combined by multiplying in GF(2) modulo the
+	polynomial: appending n bytes multiplies the CRC by x^(8n), and
+	x^(2^k) is kept for every k, as in zlib. This also gives the CRC
+	of a run of one byte (or a hole of a sparse file) without going
+	over its bytes.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include "lzwcrc.h"
+
+#if defined( __x86_64__ ) && defined( __GNUC__ )
+	#define CRC_X86
+	#include <nmmintrin.h>
+#endif
+
+/* bytes per lane of the three lanes of the CRC32 instruction. */
+#define CRC_LANE   4096
+
+static uint32_t crc_table[ 8 ][ 256 ];
+static uint32_t x2n_table[ 32 ];  /* x^(2^k) modulo the polynomial. */
+static uint32_t lane_shift;       /* x^(8*CRC_LANE). */
+static int crc_ready = 0, crc_hw = 0;
+
+/* a*b modulo the polynomial (bit 31 is x^0). */
+static uint32_t multmodp( uint32_t a, uint32_t b )
+{
+	uint32_t m = (uint32_t) 1 << 31, p = 0;
+	
+	while ( 1 ) {
+		if ( a & m ) {
+			p ^= b;
+			if ( (a & (m - 1)) == 0 ) break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+	return p;
+}
+
+/* x^(n*2^k) modulo the polynomial. */
+static uint32_t x2nmodp( int64_t n, int k )
+{
+	uint32_t p = (uint32_t) 1 << 31;
+	
+	while ( n ) {
+		if ( n & 1 ) p = multmodp( x2n_table[ k & 31 ], p );
+		n >>= 1;
+		k++;
+	}
+	return p;
+}
+
+static void crc_init( void )
+{
+	uint32_t c;
+	int i, k;
+	
+	for ( i = 0; i < 256; i++ ) {
+		c = i;
+		for ( k = 0; k < 8; k++ ) c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+		crc_table[ 0 ][ i ] = c;
+	}
+	for ( i = 0; i < 256; i++ ) {
+		for ( k = 1; k < 8; k++ ) {
+			c = crc_table[ k-1 ][ i ];
+			crc_table[ k ][ i ] = (c >> 8) ^ crc_table[ 0 ][ c & 0xff ];
+		}
+	}
+	c = (uint32_t) 1 << 30;  /* x^1 */
+	x2n_table[ 0 ] = c;
+	for ( k = 1; k < 32; k++ ) x2n_table[ k ] = c = multmodp( c, c );
+	lane_shift = x2nmodp( CRC_LANE, 3 );
+#if defined( CRC_X86 )
+	crc_hw = __builtin_cpu_supports( "sse4.2" ) != 0;
+#endif
+	crc_ready = 1;
+}
+
+/* the CRC register (not inverted) after p[0..n-1], by the tables. */
+static uint32_t crc_soft( uint32_t c, const unsigned char *p, size_t n )
+{
+	uint64_t w;
+	
+	while ( n && ((uintptr_t) p & 7) ) {
+		c = (c >> 8) ^ crc_table[ 0 ][ (c ^ *p++) & 0xff ];
+		n--;
+	}
+	while ( n >= 8 ) {
+		memcpy( &w, p, 8 );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		w = __builtin_bswap64( w );
+#endif
+		w ^= c;
+		c = crc_table[ 7 ][ w & 0xff ] ^ crc_table[ 6 ][ (w >> 8) & 0xff ]
+			^ crc_table[ 5 ][ (w >> 16) & 0xff ] ^ crc_table[ 4 ][ (w >> 24) & 0xff ]
+			^ crc_table[ 3 ][ (w >> 32) & 0xff ] ^ crc_table[ 2 ][ (w >> 40) & 0xff ]
+			^ crc_table[ 1 ][ (w >> 48) & 0xff ] ^ crc_table[ 0 ][ w >> 56 ];
+		p += 8;
+		n -= 8;
+	}
+	while ( n-- ) c = (c >> 8) ^ crc_table[ 0 ][ (c ^ *p++) & 0xff ];
+	return c;
+}
+
+#if defined( CRC_X86 )
+/* the same with the CRC32 instruction, three lanes at a time. */
+__attribute__(( target( "sse4.2" ) ))
+static uint32_t crc_sse42( uint32_t c, const unsigned char *p, size_t n )
+{
+	uint64_t c0 = c, c1, c2, w0, w1, w2;
+	size_t i;
+	
+	while ( n && ((uintptr_t) p & 7) ) {
+		c0 = _mm_crc32_u8( (uint32_t) c0, *p++ );
+		n--;
+	}
+	while ( n >= 3*CRC_LANE ) {
+		c1 = c2 = 0;
+		for ( i = 0; i < CRC_LANE; i += 8 ) {
+			memcpy( &w0, p + i, 8 );
+			memcpy( &w1, p + CRC_LANE + i, 8 );
+			memcpy( &w2, p + 2*CRC_LANE + i, 8 );
+			c0 = _mm_crc32_u64( c0, w0 );
+			c1 = _mm_crc32_u64( c1, w1 );
+			c2 = _mm_crc32_u64( c2, w2 );
+		}
+		c0 = multmodp( lane_shift, multmodp( lane_shift, (uint32_t) c0 ) ^ (uint32_t) c1 ) ^ (uint32_t) c2;
+		p += 3*CRC_LANE;
+		n -= 3*CRC_LANE;
+	}
+	while ( n >= 8 ) {
+		memcpy( &w0, p, 8 );
+		c0 = _mm_crc32_u64( c0, w0 );
+		p += 8;
+		n -= 8;
+	}
+	while ( n-- ) c0 = _mm_crc32_u8( (uint32_t) c0, *p++ );
+	return (uint32_t) c0;
+}
+#endif
+
+uint32_t crc32c( uint32_t crc, const void *p, size_t n )
+{
+	if ( !crc_ready ) crc_init();
+#if defined( CRC_X86 )
+	if ( crc_hw ) return ~crc_sse42( ~crc, (const unsigned char *) p, n );
+#endif
+	return ~crc_soft( ~crc, (const unsigned char *) p, n );
+}
+
+uint32_t crc32c_combine( uint32_t crc1, uint32_t crc2, int64_t len2 )
+{
+	if ( !crc_ready ) crc_init();
+	return multmodp( x2nmodp( len2, 3 ), crc1 ) ^ crc2;
+}
+
+uint32_t crc32c_run( int c, int64_t n )
+{
+	unsigned char b = (unsigned char) c;
+	uint32_t crc = 0, part = crc32c( 0, &b, 1 );
+	int64_t len = 1;
+	
+	/* part is the CRC of len bytes c, len = 1, 2, 4, ... */
+	while ( n ) {
+		if ( n & 1 ) crc = crc32c_combine( crc, part, len );
+		n >>= 1;
+		if ( n ) part = crc32c_combine( part, part, len );
+		len <<= 1;
+	}
+	return crc;
+}
+
+int crc32c_hw( void )
+{
+	if ( !crc_ready ) crc_init();
+	return crc_hw;
+}
@@ -0,0 +1,27 @@
+/* LZWCRC.H, the CRC32C checksums of LZWHC, 2024 */
+#include <stdint.h>  /* C99 */
+#include <stddef.h>
+
+#if !defined( LZWCRC_H )
+	#define LZWCRC_H
+
+/*
+	CRC32C (Castagnoli, reflected polynomial 0x82f63b78), the one of
+	iSCSI and ext4, that SSE4.2 computes in one instruction. The CRC
+	of no bytes is 0, and crc32c( 0, "123456789", 9 ) is 0xe3069283.
+*/
+#define CRC32C_POLY        0x82f63b78u
+
+/* the CRC of p[0..n-1] following the bytes whose CRC is crc. */
+uint32_t crc32c( uint32_t crc, const void *p, size_t n );
+
+/* the CRC of two strings, from the CRC of each and the length of the second. */
+uint32_t crc32c_combine( uint32_t crc1, uint32_t crc2, int64_t len2 );
+
+/* the CRC of n bytes c, in O(log n) time. */
+uint32_t crc32c_run( int c, int64_t n );
+
+/* 1 if crc32c() uses the CRC32 instruction of SSE4.2. */
+int crc32c_hw( void );
+
+#endif
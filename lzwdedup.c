@@ -0,0 +1,151 @@
+/*
+	Filename:  LZWDEDUP.C
+	
+	The deduplication stage of the block mode of lzwhc (--dedup): the
+	data is cut into chunks where a rolling hash of its last 64 bytes
+	(a gear hash: one shift and one add per byte) hits a pattern, so
+	the cuts move along with the content when bytes are inserted or
+	removed before them. Each chunk gets a 64-bit fingerprint, and a
+	chunk whose fingerprint and length are in the chunk table is a
+	duplicate candidate; lzwhc compares its bytes with the earlier
+	chunk before it writes a reference to it.
+	
+	The cuts and the fingerprints take a pass or two over the bytes,
+	far less than the LZW coding of the chunks that are not duplicates,
+	which lzwhc leaves to its pool of threads (LZWPOOL.C).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include "lzwdedup.h"
+
+static uint64_t gear[ 256 ];
+static int gear_ready = 0;
+
+static dedup_chunk *table = NULL;
+static int table_bits = 0;
+static size_t table_count = 0;
+
+/* the gear table: 256 fixed pseudo-random words (splitmix64). */
+static void init_gear( void )
+{
+	uint64_t x = 0x6c7a7764656475ULL, z;
+	int i;
+	
+	for ( i = 0; i < 256; i++ ) {
+		z = (x += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		gear[ i ] = z ^ (z >> 31);
+	}
+	gear_ready = 1;
+}
+
+/*
+	Bit k of the gear hash depends on the last k+1 bytes only, so the
+	cut pattern is on the top bits, and the hash is started 64 bytes
+	before the first place a cut can be made.
+*/
+size_t dedup_cut( const unsigned char *p, size_t n )
+{
+	const uint64_t mask = ((1ULL << DEDUP_MASK_BITS) - 1) << (64 - DEDUP_MASK_BITS);
+	uint64_t h = 0;
+	size_t i, max;
+	
+	if ( n <= DEDUP_MIN_CHUNK ) return n;
+	if ( !gear_ready ) init_gear();
+	max = n < DEDUP_MAX_CHUNK ? n : DEDUP_MAX_CHUNK;
+	for ( i = DEDUP_MIN_CHUNK - 64; i < DEDUP_MIN_CHUNK; i++ ) h = (h << 1) + gear[ p[ i ] ];
+	for ( ; i < max; i++ ) {
+		h = (h << 1) + gear[ p[ i ] ];
+		if ( !(h & mask) ) return i + 1;
+	}
+	return max;
+}
+
+/* a 64-bit hash of p[0..n-1], 8 bytes per multiply. */
+static uint64_t fingerprint( const unsigned char *p, size_t n )
+{
+	uint64_t h = n * 0x9e3779b97f4a7c15ULL, w;
+	
+	while ( n >= 8 ) {
+		memcpy( &w, p, 8 );
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 29;
+		p += 8;
+		n -= 8;
+	}
+	w = 0;
+	memcpy( &w, p, n );
+	h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 32);
+}
+
+void dedup_fingerprints( const unsigned char *p, const size_t *cuts, int n, uint64_t *fp )
+{
+	size_t s;
+	int i;
+	
+	for ( i = 0; i < n; i++ ) {
+		s = i ? cuts[ i-1 ] : 0;
+		fp[ i ] = fingerprint( p + s, cuts[ i ] - s );
+	}
+}
+
+dedup_chunk *dedup_find( uint64_t fp, size_t len )
+{
+	size_t mask, i;
+	
+	if ( !table ) return NULL;
+	mask = ((size_t) 1 << table_bits) - 1;
+	for ( i = fp & mask; table[ i ].len; i = (i + 1) & mask ) {
+		if ( table[ i ].fp == fp && table[ i ].len == len ) return &table[ i ];
+	}
+	return NULL;
+}
+
+/* puts a chunk in a free slot (linear probing). */
+static void put_slot( dedup_chunk *t, int bits, const dedup_chunk *c )
+{
+	size_t mask = ((size_t) 1 << bits) - 1, i;
+	
+	for ( i = c->fp & mask; t[ i ].len; i = (i + 1) & mask ) ;
+	t[ i ] = *c;
+}
+
+int dedup_insert( uint64_t fp, int64_t off, size_t len )
+{
+	dedup_chunk c, *t;
+	size_t i;
+	int bits;
+	
+	/* the table is kept at most half full; it doubles until DEDUP_MAX_BITS. */
+	if ( !table || 2 * (table_count + 1) > ((size_t) 1 << table_bits) ) {
+		if ( table && table_bits >= DEDUP_MAX_BITS ) return 0;
+		bits = table ? table_bits + 1 : DEDUP_TABLE_BITS;
+		if ( (t = (dedup_chunk *) calloc( (size_t) 1 << bits, sizeof(dedup_chunk) )) == NULL ) return 0;
+		if ( table ) {
+			for ( i = 0; i < ((size_t) 1 << table_bits); i++ ) {
+				if ( table[ i ].len ) put_slot( t, bits, &table[ i ] );
+			}
+			free( table );
+		}
+		table = t;
+		table_bits = bits;
+	}
+	c.fp = fp;
+	c.off = off;
+	c.len = (uint32_t) len;
+	put_slot( table, table_bits, &c );
+	table_count++;
+	return 1;
+}
+
+void dedup_free( void )
+{
+	if ( table ) free( table );
+	table = NULL;
+	table_bits = 0;
+	table_count = 0;
+}
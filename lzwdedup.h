@@ -0,0 +1,52 @@
+/* LZWDEDUP.H, the content-defined chunking and deduplication of LZWHC, 2024 */
+#include <stdint.h>  /* C99 */
+#include <stddef.h>
+
+#if !defined( LZWDEDUP_H )
+	#define LZWDEDUP_H
+
+/*
+	Chunk sizes: a cut is made where the top DEDUP_MASK_BITS bits of
+	the gear hash of the last 64 bytes are zero, but not before
+	DEDUP_MIN_CHUNK bytes and not after DEDUP_MAX_CHUNK bytes; the
+	chunks are some 40KB long on average.
+*/
+#define DEDUP_MIN_CHUNK    (8<<10)
+#define DEDUP_MAX_CHUNK    (128<<10)
+#define DEDUP_MASK_BITS    15
+
+/* shorter chunks (at the end of a block) are neither looked up nor kept. */
+#define DEDUP_MIN_REF      (1<<10)
+
+/* the chunk table starts with 2^DEDUP_TABLE_BITS slots and doubles up to 2^DEDUP_MAX_BITS. */
+#define DEDUP_TABLE_BITS   16
+#define DEDUP_MAX_BITS     24
+
+/* a chunk kept in the table: its fingerprint, input offset and length. */
+typedef struct {
+	uint64_t fp;
+	int64_t off;
+	uint32_t len;             /* 0 = empty slot. */
+} dedup_chunk;
+
+/* the length of the first chunk of p[0..n-1]. */
+size_t dedup_cut( const unsigned char *p, size_t n );
+
+/*
+	The fingerprints of the n chunks of p: chunk i ends at cuts[i]
+	and starts at cuts[i-1] (at 0 for i = 0).
+*/
+void dedup_fingerprints( const unsigned char *p, const size_t *cuts, int n, uint64_t *fp );
+
+/* the chunk with fingerprint fp and length len, or NULL if there is none. */
+dedup_chunk *dedup_find( uint64_t fp, size_t len );
+
+/*
+	Keeps a chunk; returns 0 if out of memory or if the table is at
+	its largest size and half full (the chunk is then not kept).
+*/
+int dedup_insert( uint64_t fp, int64_t off, size_t len );
+
+void dedup_free( void );
+
+#endif
@@ -0,0 +1,381 @@
+/*
+	Filename:  LZWENC.C
+	
+	The LZW matching kernel: takes a span of input bytes and the
+	dictionary state, and produces the array of emitted codes.
+	It does no input/output and uses no global variables, so bit
+	packing and output are separate stages in the caller.
+	
+	The dictionary is the LZC hashing of LZWHC.C. After CODE_MAX+4K
+	codes are emitted, the string table is reset (d->reset_cnt);
+	or, in the CLEAR mode, a CLEAR code is emitted and the table is
+	cleared when the compression ratio drops, as in Unix compress.
+	In the segments of the max mode, the caller picks where the table
+	is cleared (lzw_match_clear()).
+	
+	Compile with -DLZW_STATS to count the hash probes, resets and
+	emitted codes (d->stats, lzw_stats_report()).
+	
+	A program may define LZW_RESET_BEGIN() and LZW_RESET_END() before
+	including this file; they are called around each table reset.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include "lzwenc.h"
+
+#if !defined( LZW_RESET_BEGIN )
+	#define LZW_RESET_BEGIN()
+	#define LZW_RESET_END()
+#endif
+
+/* must be a prime number greater than CODE_MAX */
+static const int hash_table_sizes[ 29 ] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	     5021,      9859,     18041,     35023,
+	    69001,    134989,    279991,    539881,
+	  1249943,   2157151,   4225303,   8500249,
+	 16795123,  33559021,  67125433, 134253857,
+	268470641
+};
+
+/* allocate memory to the code tables; returns 0 on error. */
+int lzw_dict_alloc( lzw_dict *d, int code_max_bits )
+{
+	memset( d, 0, sizeof(lzw_dict) );
+	if ( code_max_bits < 12 || code_max_bits > 28 ) return 0;
+	
+	d->code_max_bits = code_max_bits;
+	d->code_MAX = 1 << code_max_bits;
+	d->reset_cnt = d->code_MAX + 4096;
+	d->start_code = START_LZW_CODE;
+	d->hash_TABLE_SIZE = hash_table_sizes[ code_max_bits ];
+	d->hash_SHIFT = code_max_bits - 8;
+	
+	d->code = (int *) malloc( sizeof(int) * d->hash_TABLE_SIZE );
+	d->prefix = (int *) malloc( sizeof(int) * d->hash_TABLE_SIZE );
+	d->character = (unsigned char *) malloc( sizeof(unsigned char) * d->hash_TABLE_SIZE );
+	if ( !d->code || !d->prefix || !d->character ) {
+		lzw_dict_free( d );
+		return 0;
+	}
+	return 1;
+}
+
+void lzw_dict_free( lzw_dict *d )
+{
+	if ( d->code ) free( d->code );
+	if ( d->prefix ) free( d->prefix );
+	if ( d->character ) free( d->character );
+	d->code = d->prefix = NULL;
+	d->character = NULL;
+}
+
+/*
+	initialize the codes with a value of LZW_NULL,
+	indicating that the hash table slot is open.
+*/
+static void init_code_table( lzw_dict *d )
+{
+	int i;
+	
+	for ( i = 0; i < d->hash_TABLE_SIZE; i++ ) {
+		d->code[ i ] = LZW_NULL;
+	}
+	d->lzw_code_cnt = d->start_code;
+	d->bit_count = 9;   /* code size starts at 9 bits. */
+	d->code_max = 512;  /* start expanding the code size if we
+	                         already reached this value. */
+	d->check_at = 0;
+	d->best_ratio = 0;
+}
+
+void lzw_dict_init( lzw_dict *d )
+{
+	init_code_table( d );
+	d->prefix_string_code = -1;
+	d->in_bytes = 0;
+}
+
+void lzw_dict_use_clear( lzw_dict *d )
+{
+	d->clear_code = CLEAR_LZW_CODE;
+	d->start_code = CLEAR_LZW_CODE + 1;
+	d->reset_cnt = 0;
+}
+
+void lzw_dict_use_segments( lzw_dict *d, int blind )
+{
+	d->clear_code = 0;
+	d->start_code = CLEAR_LZW_CODE + 1;
+	d->reset_cnt = blind ? d->code_MAX + 4096 : 0;
+}
+
+/*
+	The ratio monitor, called for each code emitted with the table
+	full; pos is the input position. Returns 1 if the ratio of the
+	last LZW_CHECK_GAP bytes dropped, or the codes now expand the
+	input, and the table should be cleared.
+*/
+static inline int ratio_dropped( lzw_dict *d, int64_t pos )
+{
+	double ratio;
+	
+	d->win_bits += d->bit_count;
+	if ( pos < d->check_at ) return 0;
+	if ( d->check_at == 0 ) {  /* the table just filled up. */
+		d->win_start = pos;
+		d->win_bits = 0;
+		d->check_at = pos + LZW_CHECK_GAP;
+		return 0;
+	}
+	ratio = (double) (pos - d->win_start) * 8 / d->win_bits;
+	d->win_start = pos;
+	d->win_bits = 0;
+	d->check_at = pos + LZW_CHECK_GAP;
+	if ( ratio > d->best_ratio ) d->best_ratio = ratio;
+	else if ( ratio < d->best_ratio * LZW_CLEAR_DROP || ratio < 1.0 ) return 1;
+	return 0;
+}
+
+/*
+	The insertion routine for the compressor, uses
+	hashing to store the codes in the code tables.
+
+	This function will always find an open slot, and
+	when it does, it immediately exits the function.
+*/
+static inline void insert_stringENC( lzw_dict *d, int prefix_code, unsigned char c )
+{
+	int hindex;       /* the hashed index address. */
+	int d2;           /* the "displacement" to compute for the new index. */
+	
+	/* first probe is the hash function itself. */
+	hindex = (c << d->hash_SHIFT) ^ prefix_code;
+	
+	/* prepare for the second probe. */
+	d2 = d->hash_TABLE_SIZE - hindex;
+	if ( hindex == 0 ) d2 = 1;
+	
+	do {
+		/* available slot; store code here. */
+		if ( d->code[ hindex ] == LZW_NULL ) {
+			d->code[ hindex ] = d->lzw_code_cnt;
+			d->prefix[ hindex ] = prefix_code;
+			d->character[ hindex ] = c;
+			return ;
+		}
+		/* otherwise, do a second probe. */
+		if ( (hindex -= d2) < 0 )
+			hindex += d->hash_TABLE_SIZE;
+	} while( 1 );
+}
+
+#if defined( LZW_STATS )
+static inline void count_probes( lzw_dict *d, int probes )
+{
+	d->stats.probe_hist[ probes < LZW_STAT_PROBES ? probes : LZW_STAT_PROBES ]++;
+	if ( probes > d->stats.max_probes ) d->stats.max_probes = probes;
+}
+
+/* fraction of the hash table in use. */
+static double load_factor( lzw_dict *d )
+{
+	int n = d->lzw_code_cnt < d->code_MAX ? d->lzw_code_cnt : d->code_MAX;
+	
+	return (double) (n - d->start_code) / d->hash_TABLE_SIZE;
+}
+#endif
+
+/*
+	Search for the string composed of a prefix code
+	and a character. Returns its code, or LZW_NULL.
+*/
+static inline int search_string( lzw_dict *d, int prefix_code, unsigned char c )
+{
+	int hindex;       /* the hashed index address. */
+	int d2;           /* the "displacement" to compute for the new index. */
+	
+	LZW_STAT( int probes = 0; )
+	
+	hindex = (c << d->hash_SHIFT) ^ prefix_code;
+	
+	if ( hindex == 0 ) d2 = 1;
+	else d2 = d->hash_TABLE_SIZE - hindex;
+	
+	do {
+		LZW_STAT( probes++; )
+		
+		/* empty slot; code pair not found. */
+		if ( d->code[ hindex ] == LZW_NULL ) break;
+		
+		/* a code pair is stored here, so check it. */
+		if (	d->prefix[ hindex ] == prefix_code
+					&& d->character[ hindex ] == c ) { /* a match! */
+			LZW_STAT( d->stats.hits++; d->stats.hit_probes += probes; )
+			LZW_STAT( count_probes( d, probes ); )
+			return d->code[ hindex ];
+		}
+		
+		/* second probe; find another available slot. */
+		if ( (hindex -= d2) < 0 )
+			hindex += d->hash_TABLE_SIZE;
+	} while( 1 );
+	
+	LZW_STAT( d->stats.misses++; d->stats.miss_probes += probes; )
+	LZW_STAT( count_probes( d, probes ); )
+	return LZW_NULL;
+}
+
+/* resets (or clears) the string table in the middle of the input. */
+static void reset_table( lzw_dict *d )
+{
+	d->resets++;
+#if defined( LZW_STATS )
+	d->stats.load_sum += load_factor( d );
+	if ( load_factor( d ) > d->stats.load_max ) d->stats.load_max = load_factor( d );
+#endif
+	LZW_RESET_BEGIN();
+	init_code_table( d );
+	LZW_RESET_END();
+}
+
+size_t lzw_match( lzw_dict *d, const unsigned char **pp,
+	const unsigned char *end, uint32_t *out, size_t max )
+{
+	const unsigned char *p = *pp;
+	int prefix_string_code = d->prefix_string_code, c, k;
+	size_t n = 0;
+	
+	if ( max < LZW_MATCH_MIN ) return 0;
+	
+	/* get first character. */
+	if ( prefix_string_code < 0 && p < end ) {
+		prefix_string_code = *p++;	/* first prefix code. */
+	}
+	
+	while ( p < end ) {
+		c = *p++;
+		if ( (k = search_string( d, prefix_string_code, c )) != LZW_NULL ) {
+			prefix_string_code = k;
+			continue;
+		}
+		out[ n++ ] = (uint32_t) prefix_string_code;
+		LZW_STAT( d->stats.codes[ d->bit_count ]++; )
+		
+		/* ---- insert the string in the string table. ---- */
+		if ( d->lzw_code_cnt < d->code_MAX ){
+			insert_stringENC( d, prefix_string_code, c );
+			if ( d->lzw_code_cnt == d->code_max ) {
+				d->bit_count++;
+				d->code_max <<= 1;
+				out[ n++ ] = LZW_WIDTH_MARK | d->bit_count;
+			}
+			d->lzw_code_cnt++;
+		}
+		else if ( d->reset_cnt == 0 ) {
+			/* the table stays full; in the CLEAR mode, clear it when the ratio drops. */
+			if ( d->clear_code && ratio_dropped( d, d->in_bytes + (p - *pp) ) ) {
+				out[ n++ ] = (uint32_t) d->clear_code;
+				reset_table( d );
+				out[ n++ ] = LZW_WIDTH_MARK | d->bit_count;
+			}
+		}
+		
+		/*  Instead of monitoring comp. ratio, we simply reset 
+			the string table after N output codes. 
+			No CLEAR_TABLE code is transmitted. */
+		else if ( d->lzw_code_cnt++ == d->reset_cnt ) {
+			reset_table( d );
+			out[ n++ ] = LZW_WIDTH_MARK | d->bit_count;
+		}
+		
+		/* string = char */
+		prefix_string_code = c;
+		
+		if ( max - n < LZW_MATCH_MIN ) break;
+	}
+	d->prefix_string_code = prefix_string_code;
+	d->in_bytes += p - *pp;
+	LZW_STAT( d->stats.bytes += p - *pp; )
+	*pp = p;
+	return n;
+}
+
+/* emits the last string, then end_code. */
+static size_t match_end( lzw_dict *d, uint32_t *out, int end_code )
+{
+	size_t n = 0;
+	
+	/* output last code. */
+	if ( d->prefix_string_code >= 0 )
+		out[ n++ ] = (uint32_t) d->prefix_string_code;
+	
+	out[ n++ ] = (uint32_t) end_code;
+	LZW_STAT( d->stats.codes[ d->bit_count ] += n; )
+	d->prefix_string_code = -1;
+	return n;
+}
+
+size_t lzw_match_end( lzw_dict *d, uint32_t *out )
+{
+	/* output END-of-FILE code.*/
+	return match_end( d, out, EOF_LZW_CODE );
+}
+
+size_t lzw_match_clear( lzw_dict *d, uint32_t *out )
+{
+	return match_end( d, out, CLEAR_LZW_CODE );
+}
+
+int64_t lzw_count_bits( const uint32_t *out, size_t n, int *width )
+{
+	int64_t bits = 0;
+	int w = *width;
+	
+	while ( n-- ) {
+		if ( *out & LZW_WIDTH_MARK ) w = *out & 0xff;
+		else bits += w;
+		out++;
+	}
+	*width = w;
+	return bits;
+}
+
+#if defined( LZW_STATS )
+void lzw_stats_report( lzw_dict *d, FILE *fp )
+{
+	lzw_stats *s = &d->stats;
+	uint64_t ncodes = 0;
+	int i;
+	
+	for ( i = 9; i <= 28; i++ ) ncodes += s->codes[ i ];
+	
+	fprintf(fp, "\n\n---- dictionary statistics (%d-bit table, %d hash slots) ----",
+		d->code_max_bits, d->hash_TABLE_SIZE );
+	fprintf(fp, "\nsuccessful searches    = %15llu, %6.3f probes/search",
+		(unsigned long long) s->hits, s->hits ? (double) s->hit_probes / s->hits : 0.0 );
+	fprintf(fp, "\nunsuccessful searches  = %15llu, %6.3f probes/search",
+		(unsigned long long) s->misses, s->misses ? (double) s->miss_probes / s->misses : 0.0 );
+	fprintf(fp, "\nlongest probe sequence = %15d", s->max_probes );
+	fprintf(fp, "\nprobe lengths:");
+	for ( i = 1; i <= LZW_STAT_PROBES; i++ ) {
+		if ( s->probe_hist[ i ] == 0 ) continue;
+		fprintf(fp, "\n  %s%2d  %15llu", i == LZW_STAT_PROBES ? ">=" : "  ", i,
+			(unsigned long long) s->probe_hist[ i ] );
+	}
+	fprintf(fp, "\nresets                 = %15d", d->resets );
+	if ( d->resets )
+		fprintf(fp, "\nload factor at reset   = %6.3f average, %6.3f maximum",
+			s->load_sum / d->resets, s->load_max );
+	fprintf(fp, "\nload factor now        = %6.3f", load_factor( d ) );
+	fprintf(fp, "\ncodes emitted per code size:");
+	for ( i = 9; i <= 28; i++ ) {
+		if ( s->codes[ i ] )
+			fprintf(fp, "\n  %2d bits  %15llu", i, (unsigned long long) s->codes[ i ] );
+	}
+	fprintf(fp, "\naverage phrase length  = %6.3f bytes\n",
+		ncodes ? (double) s->bytes / ncodes : 0.0 );
+}
+#endif
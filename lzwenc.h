@@ -0,0 +1,137 @@
+/* LZWENC.H, the LZW matching kernel of LZWHC.C, 2024 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWENC_H )
+	#define LZWENC_H
+
+#define EOF_LZW_CODE     256
+#define LZW_NULL         256
+#define START_LZW_CODE   257
+
+/* with lzw_dict_use_clear(), code 257 clears the table. */
+#define CLEAR_LZW_CODE   257
+
+/*
+	The ratio monitor of the CLEAR mode: once the table is full, the
+	ratio of every LZW_CHECK_GAP input bytes is compared with the best
+	one since the table filled; the table is cleared when it falls
+	below LZW_CLEAR_DROP times that, or below 1 (expansion).
+*/
+#define LZW_CHECK_GAP    16384
+#define LZW_CLEAR_DROP   0.90
+
+/*
+	An entry of the code array with LZW_WIDTH_MARK set is not a
+	code: the code size of the following codes is (entry & 0xff).
+*/
+#define LZW_WIDTH_MARK   0x80000000u
+
+/* smallest room in the code array that lzw_match() accepts. */
+#define LZW_MATCH_MIN      3
+
+/*
+	Dictionary statistics, compiled in with -DLZW_STATS only;
+	LZW_STAT(x) expands to x then, and to nothing otherwise.
+*/
+#if defined( LZW_STATS )
+	#define LZW_STAT(x)  x
+
+/* probe lengths >= LZW_STAT_PROBES share the last bucket. */
+#define LZW_STAT_PROBES   32
+
+typedef struct {
+	uint64_t hits, hit_probes;       /* successful searches. */
+	uint64_t misses, miss_probes;    /* unsuccessful searches. */
+	uint64_t probe_hist[ LZW_STAT_PROBES+1 ];
+	int max_probes;
+	double load_sum, load_max;       /* load factor at the resets. */
+	uint64_t codes[ 29 ];            /* codes emitted per code size. */
+	uint64_t bytes;                  /* input bytes matched. */
+} lzw_stats;
+#else
+	#define LZW_STAT(x)
+#endif
+
+/*
+	The dictionary state: the hash tables plus everything
+	the kernel needs to continue matching at the next call.
+*/
+typedef struct {
+	int *code;                /* the hash tables. */
+	int *prefix;
+	unsigned char *character;
+	int hash_TABLE_SIZE, hash_SHIFT;
+	
+	int code_max_bits, code_MAX;
+	int reset_cnt;            /* reset after this code count; 0 = never. */
+	int clear_code;           /* 0, or CLEAR_LZW_CODE (lzw_dict_use_clear()). */
+	int start_code;           /* first code to define. */
+	
+	int lzw_code_cnt;         /* next code to define. */
+	int bit_count;            /* current code size. */
+	int code_max;             /* code size grows when lzw_code_cnt reaches this. */
+	int prefix_string_code;   /* the string being matched; -1 = none yet. */
+	int resets;               /* string table resets (or clears) so far. */
+	
+	/* the ratio monitor of the CLEAR mode. */
+	int64_t in_bytes;         /* input bytes matched before this lzw_match() call. */
+	int64_t check_at;         /* next check; 0 = table not full yet. */
+	int64_t win_start, win_bits;
+	double best_ratio;
+#if defined( LZW_STATS )
+	lzw_stats stats;
+#endif
+} lzw_dict;
+
+int  lzw_dict_alloc( lzw_dict *d, int code_max_bits );
+void lzw_dict_free( lzw_dict *d );
+void lzw_dict_init( lzw_dict *d );
+
+/*
+	Switches to the CLEAR mode: no blind resets; once the table is
+	full, CLEAR_LZW_CODE is emitted and the table is cleared when the
+	compression ratio drops. The first code to define is 258.
+*/
+void lzw_dict_use_clear( lzw_dict *d );
+
+/*
+	Switches to the segments of the max mode: the first code to define
+	is 258, as in the CLEAR mode, but the caller decides where a
+	segment ends (lzw_match_clear()). Inside a segment, the table is
+	reset after CODE_MAX+4K codes if blind is nonzero, and stays full
+	otherwise. Call before lzw_dict_init().
+*/
+void lzw_dict_use_segments( lzw_dict *d, int blind );
+
+/*
+	Matches the bytes at *pp up to end. Emitted codes and code size
+	changes go to out[], which has room for max entries. Returns the
+	number of entries written and advances *pp to the first unread
+	byte, which is before end only if out[] is full.
+*/
+size_t lzw_match( lzw_dict *d, const unsigned char **pp,
+	const unsigned char *end, uint32_t *out, size_t max );
+
+/* Ends the input: emits the last string and the END-of-FILE code. */
+size_t lzw_match_end( lzw_dict *d, uint32_t *out );
+
+/*
+	Ends a segment: emits the last string and CLEAR_LZW_CODE. The
+	next segment starts with lzw_dict_init().
+*/
+size_t lzw_match_clear( lzw_dict *d, uint32_t *out );
+
+/*
+	The size in bits of the codes in out[0..n-1], as packed; *width is
+	the code size before out[0], and is updated by the size changes.
+*/
+int64_t lzw_count_bits( const uint32_t *out, size_t n, int *width );
+
+#if defined( LZW_STATS )
+/* Prints the dictionary statistics so far. */
+void lzw_stats_report( lzw_dict *d, FILE *fp );
+#endif
+
+#endif
@@ -30,6 +30,8 @@
 #include "utypes.h"
 #include "gtbitio2.c"
 #include "lzwbt.c"
+#include "lzwrun.c"
+#include "lzwhdr.c"
 
 #define CODE_MAX_BITS     16   /* default */
 
@@ -38,11 +40,6 @@
 
 #define output_code(a,b) put_nbits((a), (b))
 
-typedef struct {
-	char algorithm[4];
-	int code_max_bits;
-} file_stamp;
-
 int code_MAX = (1<<CODE_MAX_BITS);   /* STRING_TABLE_SIZE, default = 65536 */
 
 int bit_count =   9;  /* code size starts at 9 bits. */
@@ -64,9 +61,9 @@ int main( int argc, char *argv[] )
 	float ratio = 0.0;
 	int c = 0, code_max_bits = CODE_MAX_BITS;
 	int in_argn = 1, out_argn = 2;
-	file_stamp fstamp;
+	lzw_header hdr;
 	
-	clock_t start_time = clock();
+	double start_time = wall_time();
 	
 	if ( argc == 4 ) {
 		if ( argv[1][0] == '-' && argv[1][1] != '\0' ) {
@@ -118,11 +115,9 @@ int main( int argc, char *argv[] )
 	
 	if ( nfread == 0 ) goto done_compression;  /* file length = 0 */
 	
-	/* Write the FILE STAMP. */
-	strcpy( fstamp.algorithm, "LZW" );
-	fstamp.code_max_bits = code_max_bits;
-	fwrite( &fstamp, sizeof(file_stamp), 1, pOUT );
-	nbytes_out = sizeof(file_stamp);
+	/* Write the header (see LZWHDR.H). */
+	hdr_init( &hdr, HDR_LZWG, HDR_RESET_BLIND, code_max_bits, gIN );
+	nbytes_out = hdr_write( pOUT, &hdr );
 	
 	/* start of codes to define. */
 	lzw_code_cnt = START_LZW_CODE;
@@ -181,7 +176,7 @@ int main( int argc, char *argv[] )
 						/ (float) nbytes_read ) * (float) 100));
 
 	fprintf(stderr, "\nCompression ratio:         %15.2f %% in %3.2f secs.\n", ratio, 
-		(double) (clock()-start_time) / CLOCKS_PER_SEC );
+		wall_time() - start_time );
 
 	halt_prog:
 	
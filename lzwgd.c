@@ -10,32 +10,34 @@
 #include "utypes.h"
 #include "gtbitio2.c"
 #include "lzwbt.c"
+#include "lzwrun.c"
+#include "lzwhdr.c"
 
 #define EOF_LZW_CODE     256
 #define START_LZW_CODE   257
 
-typedef struct {
-	char algorithm[4];
-	int code_max_bits;
-} file_stamp;
-
-int code_MAX = 0;
+unsigned int code_MAX = 0;
 
 int bit_count = 9;  /* code size starts at 9 bits. */
-int code_max = 512; /* start expanding the code size if we
-                         already reached this value. */
+unsigned int code_max = 512; /* start expanding the code size if we
+                                  already reached this value. */
+
+unsigned char *out, *stack=NULL;
 
-unsigned char *stack_buffer, *stack=NULL;
+/* bad codes found by the decoder. */
+int decode_errors = 0;
 
 void copyright( void );
+void bad_code( int c );
 
 int main( int argc, char *argv[] )
 {
-	file_stamp fstamp;
-	int old_lzw_code = 0, new_lzw_code = 0, lzwcode;
-	int code_max_bits;
+	lzw_header hdr;
+	unsigned int old_lzw_code = 0, new_lzw_code = 0, lzwcode, len;
+	int code_max_bits, hsize, members = 0;
+	int64_t member_at = 0, member_out = 0;
 	
-	clock_t start_time = clock();
+	double start_time = wall_time();
 	
 	if ( argc != 3 ) {
 		fprintf(stderr, "\n Usage: lzwgd infile outfile");
@@ -61,23 +63,28 @@ int main( int argc, char *argv[] )
 	if ( fgetc(gIN) == EOF ) goto done_decompression;  /* file length = 0 */
 	else rewind(gIN);
 	
-	/* read the file header, */
-	fread( &fstamp, sizeof( file_stamp ), 1, gIN );
-	code_max_bits = fstamp.code_max_bits;
+	/* read the file header (or the old file stamp, code_max_bits), */
+	if ( !(hsize = hdr_read( gIN, &hdr, 1 )) ) {
+		fprintf(stderr, "\nError: not an LZW file.");
+		decode_errors++;
+		goto done_decompression;
+	}
+	/* each member of files joined with cat (see LZWHDR.H) starts here. */
+	next_member:
+	if ( !hdr_check( &hdr, HDR_LZWG ) ) {
+		decode_errors++;
+		goto done_decompression;
+	}
+	/* (a member of another code size gets its own code tables.) */
+	if ( members && hdr.bits != code_max_bits ) free_code_tables();
+	code_max_bits = hdr.bits;
 	code_MAX = (1 << code_max_bits);
 	
 	/* initialize the input buffer. */
 	init_get_buffer();
 	
-	/* allocate memory for the stack buffer. */
-	stack_buffer = (unsigned char *) malloc( sizeof(unsigned char) * code_MAX );
-	if ( !stack_buffer ) {
-		fprintf(stderr, "\nError alloc: stack buffer.");
-		goto halt_prog;
-	}
-	
 	/* allocate and initialize the code tables. */
-	if ( !alloc_code_tables(code_MAX, LZW_DECOMPRESS) ) {
+	if ( !code_char && !alloc_code_tables(code_MAX, LZW_DECOMPRESS) ) {
 		fprintf( stderr, "\nError alloc!");
 		goto halt_prog;
 	}
@@ -85,9 +92,15 @@ int main( int argc, char *argv[] )
 	
 	/* set the starting code to define. */
 	lzw_code_cnt = START_LZW_CODE;
+	bit_count = 9;
+	code_max = 512;
 	
 	/* get first code. */
 	old_lzw_code = get_nbits( bit_count );
+	if ( old_lzw_code > 255 ) {
+		bad_code( old_lzw_code );
+		goto done_decompression;
+	}
 	
 	/* first code is a character; output it. */
 	pfputc( (unsigned char) old_lzw_code );
@@ -96,28 +109,35 @@ int main( int argc, char *argv[] )
 		new_lzw_code = get_nbits( bit_count );
 		
 		if ( new_lzw_code == EOF_LZW_CODE ) break;
+		else if ( nfread == 0 || new_lzw_code > lzw_code_cnt ) {
+			bad_code( new_lzw_code );
+			break;
+		}
 		else if ( new_lzw_code >= lzw_code_cnt ) lzwcode = old_lzw_code;
 		else lzwcode = new_lzw_code;
 		
-		/* GET STRING/PATTERN. */
-		stack = stack_buffer;
+		/* reserve the string (and K, if undefined code) in the output buffer. */
+		len = code_len[ lzwcode ];
+		out = pfreserve( len+1 );
+		
+		/* GET STRING/PATTERN; write it back to front at its final position. */
+		stack = out + len;
 		while ( lzwcode > EOF_LZW_CODE ) {
-			*stack++ = code_char[ lzwcode ];
+			*--stack = code_char[ lzwcode ];
 			/* when loop exits, lzwcode must be a character. */
 			lzwcode = code_prefix[ lzwcode ];
 		}
 		
 		/* K = get first character of string. */
-		*stack = lzwcode;
+		*--stack = lzwcode;
 		
-		/* OUTPUT STRING/PATTERN. */
-		while ( stack >= stack_buffer ) {
-			pfputc( *stack-- );
-		}
 		/* if undefined code. */
 		if ( new_lzw_code >= lzw_code_cnt ) {
-			pfputc( lzwcode );
+			out[ len++ ] = lzwcode;
 		}
+		
+		/* OUTPUT STRING/PATTERN. */
+		pfcommit( len );
 
 		/* add PREV_CODE+K to the string table. */
 		if ( lzw_code_cnt < code_MAX ) {
@@ -141,16 +161,34 @@ int main( int argc, char *argv[] )
 			
 			/* get first code. */
 			old_lzw_code = get_nbits( bit_count );
+			if ( old_lzw_code == EOF_LZW_CODE ) break;
+			if ( nfread == 0 || old_lzw_code > 255 ) {
+				bad_code( old_lzw_code );
+				break;
+			}
 			
 			/* first code is a character; output it. */
 			pfputc( (unsigned char) old_lzw_code );
 		}
 	}
 	flush_put_buffer();
+	if ( !hdr_check_size( &hdr, nbytes_out - member_out ) ) decode_errors++;
+	
+	/* the next member, if any. */
+	if ( !decode_errors && !hdr.legacy ) {
+		member_at += hsize + get_nbytes_used();
+		if ( (hsize = hdr_next_member( gIN, member_at, &hdr )) > 0 ) {
+			free_get_buffer();
+			member_out = nbytes_out;
+			members++;
+			goto next_member;
+		}
+		if ( hsize < 0 ) fprintf(stderr, "\nWarning: bytes after the last member, ignored.");
+	}
 	
 	done_decompression:
 	
-	fprintf(stderr, "done, in %3.2f secs.", (double) (clock()-start_time) / CLOCKS_PER_SEC );
+	fprintf(stderr, "done, in %3.2f secs.", wall_time() - start_time );
 	fprintf(stderr, "\nName of output file: %s\n", argv[2] );
 
 	halt_prog:
@@ -158,10 +196,21 @@ int main( int argc, char *argv[] )
 	free_get_buffer();
 	free_put_buffer();
 	free_code_tables();
-	if ( stack_buffer ) free( stack_buffer );
 	if ( gIN ) fclose( gIN );
 	if ( pOUT ) fclose( pOUT );
-	return 0;
+	return decode_errors != 0;
+}
+
+/*
+	Reports a code that cannot come next in the stream, or the end of
+	the input before the END-of-FILE code, with the output byte there.
+*/
+void bad_code( int c )
+{
+	if ( nfread == 0 ) fprintf(stderr, "\nError: the input ends before the END-of-FILE code, at output byte %lld.",
+		(long long) (nbytes_out + pbuf_count) );
+	else fprintf(stderr, "\nError: bad code %d at output byte %lld.", c, (long long) (nbytes_out + pbuf_count) );
+	decode_errors++;
 }
 
 void copyright( void )
@@ -31,6 +31,7 @@
 #include "utypes.h"
 #include "gtbitio2.c"
 #include "lzwbt.c"
+#include "lzwhdr.c"
 
 #define CODE_MAX_BITS     16
 #define CODE_MAX          (1<<(CODE_MAX_BITS))
@@ -40,11 +41,6 @@
 
 #define output_code(a,b) put_nbits((a), (b))
 
-typedef struct {
-	char algorithm[4];
-	int N;
-} file_stamp;
-
 int bit_count =   9;  /* code size starts at 9 bits. */
 int code_max  = 512;  /* start expanding the code size if we
                            already reached this value. */
@@ -63,7 +59,7 @@ int main( int argc, char *argv[] )
 	unsigned long in_file_len = 0, out_file_len = 0;
 	float ratio = 0.0;
 	int c = 0, n, N = CODE_MAX;
-	file_stamp fstamp;
+	lzw_header hdr;
 	
 	if ( argc != 4 ) {
 		usage();
@@ -101,11 +97,11 @@ int main( int argc, char *argv[] )
 	in_file_len = ftell( gIN );
 	fprintf(stderr, "\nLength of input file     = %15lu bytes", in_file_len );
 	
-	/* Write the FILE STAMP. */
+	/* Write the header (see LZWHDR.H); N is CODE_MAX+(1<<n), or CODE_MAX if n is 0. */
 	rewind( pOUT );
-	strcpy( fstamp.algorithm, "LZW" );
-	fstamp.N = N;
-	fwrite( &fstamp, sizeof(file_stamp), 1, pOUT );
+	hdr_init( &hdr, HDR_LZWGT, HDR_RESET_BLIND, CODE_MAX_BITS, gIN );
+	hdr.param = n;
+	hdr_write( pOUT, &hdr );
 	
 	/* start Compressing to output file. */
 	fprintf(stderr, "\n\nCompressing...");
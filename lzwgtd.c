@@ -9,6 +9,7 @@
 #include "utypes.h"
 #include "gtbitio2.c"
 #include "lzwbt.c"
+#include "lzwhdr.c"
 
 #define CODE_MAX_BITS     16
 #define CODE_MAX        (1<<CODE_MAX_BITS)
@@ -18,24 +19,25 @@
 
 #define get_code() get_nbits( bit_count )
 
-typedef struct {
-	char algorithm[4];
-	int N;
-} file_stamp;
-
 int bit_count = 9;  /* code size starts at 9 bits. */
-int code_max = 512; /* start expanding the code size if we
-                         already reached this value. */
+unsigned int code_max = 512; /* start expanding the code size if we
+                                  already reached this value. */
+
+unsigned char *out, *stack=NULL;
 
-unsigned char stack_buffer[ CODE_MAX ], *stack=NULL;
+/* bad codes found by the decoder. */
+int decode_errors = 0;
 
 void copyright( void );
+void bad_code( int c );
 
 int main( int argc, char *argv[] )
 {
-	file_stamp fstamp;
-	int old_lzw_code = 0, new_lzw_code = 0, lzwcode;
-	int N;
+	lzw_header hdr;
+	unsigned int old_lzw_code = 0, new_lzw_code = 0, lzwcode, len;
+	unsigned int N;
+	int hsize, members = 0;
+	int64_t member_at = 0, member_out = 0;
 	
 	if ( argc != 3 ) {
 		fprintf(stderr, "\n Usage: lzwgtd infile outfile");
@@ -58,17 +60,34 @@ int main( int argc, char *argv[] )
 	/* start deCompressing to output file. */
 	fprintf(stderr, "\n Decompressing...");
 
-	/* read the file header, */
-	fread( &fstamp, sizeof( file_stamp ), 1, gIN );
+	/* read the file header (or the old file stamp, N), */
+	if ( !(hsize = hdr_read( gIN, &hdr, 1 )) ) {
+		fprintf(stderr, "\nError: not an LZW file.");
+		decode_errors++;
+		goto done_decompression;
+	}
+	/* each member of files joined with cat (see LZWHDR.H) starts here. */
+	next_member:
+	if ( !hdr_check( &hdr, HDR_LZWGT ) ) {
+		decode_errors++;
+		goto done_decompression;
+	}
+	if ( !hdr.legacy && hdr.bits != CODE_MAX_BITS ) {
+		fprintf(stderr, "\nError: a code size of %d bits (this decoder is built for %d).",
+			hdr.bits, CODE_MAX_BITS );
+		decode_errors++;
+		goto done_decompression;
+	}
 	
 	/* and initialize the input buffer. */
 	init_get_buffer();
 	if ( nfread == 0 ) goto done_decompression;
 	
-	N = fstamp.N;
+	if ( hdr.legacy ) N = hdr.legacy_int[ 0 ];
+	else N = CODE_MAX + (hdr.param ? 1 << hdr.param : 0);
 	
 	/* allocate and initialize the code tables. */
-	if ( !alloc_code_tables(CODE_MAX, LZW_DECOMPRESS) ) {
+	if ( !members && !alloc_code_tables(CODE_MAX, LZW_DECOMPRESS) ) {
 		fprintf( stderr, "\nError alloc!");
 		goto halt_prog;
 	}
@@ -76,9 +95,15 @@ int main( int argc, char *argv[] )
 	
 	/* set the starting code to define. */
 	lzw_code_cnt = START_LZW_CODE;
+	bit_count = 9;
+	code_max = 512;
 	
 	/* get first code. */
 	old_lzw_code = get_nbits( bit_count );
+	if ( old_lzw_code > 255 ) {
+		bad_code( old_lzw_code );
+		goto done_decompression;
+	}
 	
 	/* first code is a character; output it. */
 	pfputc( (unsigned char) old_lzw_code );
@@ -87,29 +112,36 @@ int main( int argc, char *argv[] )
 		new_lzw_code = get_nbits( bit_count );
 		
 		if ( new_lzw_code == EOF_LZW_CODE ) break;
+		else if ( nfread == 0 || new_lzw_code > lzw_code_cnt ) {
+			bad_code( new_lzw_code );
+			break;
+		}
 		else if ( new_lzw_code >= lzw_code_cnt ) lzwcode = old_lzw_code;
 		else lzwcode = new_lzw_code;
 		
-		/* GET STRING/PATTERN. */
-		stack = stack_buffer;
+		/* reserve the string (and K, if undefined code) in the output buffer. */
+		len = code_len[ lzwcode ];
+		out = pfreserve( len+1 );
+		
+		/* GET STRING/PATTERN; write it back to front at its final position. */
+		stack = out + len;
 		while ( lzwcode > EOF_LZW_CODE ) {
-			*stack++ = code_char[ lzwcode ];
+			*--stack = code_char[ lzwcode ];
 			/* when loop exits, lzwcode must be a character. */
 			lzwcode = code_prefix[ lzwcode ];
 		}
 		
 		/* K = get first character of string. */
-		*stack = lzwcode;
+		*--stack = lzwcode;
 		
-		/* OUTPUT STRING/PATTERN. */
-		while( stack >= stack_buffer ) {
-			pfputc( *stack-- );
-		}
 		/* if undefined code. */
 		if ( new_lzw_code >= lzw_code_cnt ) {
-			pfputc( lzwcode );
+			out[ len++ ] = lzwcode;
 		}
 		
+		/* OUTPUT STRING/PATTERN. */
+		pfcommit( len );
+		
 		/* add PREV_CODE+K to the string table. */
 		if ( lzw_code_cnt < CODE_MAX ) {
 			lzw_decomp_insert( old_lzw_code, (unsigned char) lzwcode );
@@ -132,12 +164,30 @@ int main( int argc, char *argv[] )
 			
 			/* get first code. */
 			old_lzw_code = get_nbits( bit_count );
+			if ( old_lzw_code == EOF_LZW_CODE ) break;
+			if ( nfread == 0 || old_lzw_code > 255 ) {
+				bad_code( old_lzw_code );
+				break;
+			}
 			
 			/* first code is a character; output it. */
 			pfputc( (unsigned char) old_lzw_code );
 		}
 	}
 	flush_put_buffer();
+	if ( !hdr_check_size( &hdr, nbytes_out - member_out ) ) decode_errors++;
+	
+	/* the next member, if any. */
+	if ( !decode_errors && !hdr.legacy ) {
+		member_at += hsize + get_nbytes_used();
+		if ( (hsize = hdr_next_member( gIN, member_at, &hdr )) > 0 ) {
+			free_get_buffer();
+			member_out = nbytes_out;
+			members++;
+			goto next_member;
+		}
+		if ( hsize < 0 ) fprintf(stderr, "\nWarning: bytes after the last member, ignored.");
+	}
 	
 	done_decompression:
 	
@@ -151,7 +201,19 @@ int main( int argc, char *argv[] )
 	free_code_tables();
 	if ( gIN ) fclose( gIN );
 	if ( pOUT ) fclose( pOUT );
-	return 0;
+	return decode_errors != 0;
+}
+
+/*
+	Reports a code that cannot come next in the stream, or the end of
+	the input before the END-of-FILE code, with the output byte there.
+*/
+void bad_code( int c )
+{
+	if ( nfread == 0 ) fprintf(stderr, "\nError: the input ends before the END-of-FILE code, at output byte %lld.",
+		(long long) (nbytes_out + pbuf_count) );
+	else fprintf(stderr, "\nError: bad code %d at output byte %lld.", c, (long long) (nbytes_out + pbuf_count) );
+	decode_errors++;
 }
 
 void copyright( void )
@@ -26,6 +26,7 @@
 #include <string.h>
 #include "utypes.h"
 #include "gtbitio2.c"
+#include "lzwhdr.c"
 
 #define CODE_MAX_BITS     16
 #define CODE_MAX        (1<<CODE_MAX_BITS)
@@ -51,11 +52,6 @@
 
 #define output_code(a,b) put_nbits((a), (b))
 
-typedef struct {
-	char algorithm[4];
-	int N;
-} file_stamp;
-
 int code[ HASH_TABLE_SIZE ];
 int prefix[ HASH_TABLE_SIZE ];
 unsigned char character[ HASH_TABLE_SIZE ];
@@ -168,8 +164,8 @@ int main( int argc, char *argv[] )
 {
 	unsigned long in_file_len = 0, out_file_len = 0;
 	float ratio = 0.0;
-	int c_eof = 0, i, N = CODE_MAX;
-	file_stamp fstamp;
+	int c_eof = 0, i, n = 0, N = CODE_MAX;
+	lzw_header hdr;
 	
 	if ( argc != 4 ) {
 		usage();
@@ -177,8 +173,10 @@ int main( int argc, char *argv[] )
 		exit (0);
 	}
 	
-	if ( argv[1][0] == '-' && argv[1][1] != '\0' ) 
-		i = (1<<(atoi(&argv[1][1])));
+	if ( argv[1][0] == '-' && argv[1][1] != '\0' ) {
+		n = atoi(&argv[1][1]);
+		i = (1<<n);
+	}
 	else {
 		usage();
 		copyright();
@@ -205,11 +203,11 @@ int main( int argc, char *argv[] )
 	in_file_len = ftell( gIN );
 	fprintf(stderr, "\nLength of input file     = %15lu bytes", in_file_len );
 	
-	/* Write the FILE STAMP. */
+	/* Write the header (see LZWHDR.H); N is CODE_MAX+(1<<n). */
 	rewind( pOUT );
-	strcpy( fstamp.algorithm, "LZW" );
-	fstamp.N = N;
-	fwrite( &fstamp, sizeof(file_stamp), 1, pOUT );
+	hdr_init( &hdr, HDR_LZWH, HDR_RESET_BLIND, CODE_MAX_BITS, gIN );
+	hdr.param = n;
+	hdr_write( pOUT, &hdr );
 
 	/* start Compressing to output file. */
 	fprintf(stderr, "\n\n Compressing...");
@@ -11,26 +11,182 @@
 	
 	Usage:
 	
-		lzwhc [-c[N]] [-d] inputfile outputfile
+		lzwhc [-c[N]] [-a|-m|--auto[=obj]] [-b[K]] [--dedup] [--no-scan] [--no-runs]
+		      [--threads=n] [--crc] [-d|-t] [--index[=file]] [--range=off,len] [--stats=json]
+		      [--perf] [--trace=file] [--progress[=secs]] [--status=file] inputfile outputfile
 	
 	where N is bitsize of dictionary table size CODE_MAX. N is optional (default=16) 
 	and N >= 12. After CODE_MAX+4K codes are transmitted, we reset the string table.
+	
+	-a (adaptive) uses the CLEAR mode instead: code 257 is reserved as the CLEAR
+	code, and once the table is full, it is sent and the table cleared only when
+	the compression ratio drops (see LZWENC.H). The mode is stored in the file
+	header, so -d needs no option.
+	
+	-m (max) is for data compressed once and read many times: it tries segments
+	of the input with code sizes 12, 14, ... up to N (20 at most), with blind
+	resets or a full table, on all the processors, and picks the segments and
+	their code sizes that give the smallest file (see LZWMAX.C). It keeps the
+	whole input in memory and is much slower than the other modes; decoding is
+	as fast as ever.
+	
+	--auto picks the code size (up to N, default 20) and -a or not by
+	compressing a small sample of the input with each setting (see LZWAUTO.C).
+	obj is "balanced" (default; the best ratio among the settings at least 2/3
+	as fast as the fastest one), "ratio" or "speed". The setting picked is
+	stored in the file header as usual.
+	
+	-b[K] (blocks) compresses each block of K KB (default 1024) with a table of
+	its own, and stores the block raw if its codes would take as many bytes as
+	the block: already compressed or encrypted parts of the input then cost
+	a copy to decode (in the kernel with copy_file_range() on Linux), not LZW.
+	Before that, the order-0 entropy of a few samples of each block is measured
+	(see LZWSCAN.C), and a block near 8 bits per byte is stored raw without
+	running LZW at all; --no-scan turns this off. Runs of one byte of at least
+	BLOCK_RUN_MIN bytes are cut out of the blocks and stored as RUN blocks of
+	one byte each (merged across blocks), so that zero-filled regions cost
+	neither codes nor table entries; --no-runs turns this off. The holes of a
+	sparse input file are found with SEEK_DATA/SEEK_HOLE and become RUN blocks
+	without being read, and the decoder turns RUN blocks of zeros back into
+	holes of a regular output file by seeking past them.
+	
+	The blocks are coded by a pool of threads (see LZWPOOL.C), each with a
+	table of its own, while the main thread reads the input, cuts out the
+	runs and the duplicates, and writes the blocks as they come back, in
+	the order of the input; the file is the same with any number of threads.
+	--threads=n sets the number of threads, the main thread included
+	(default one per processor); -m and --auto take it too.
+	
+	--dedup (implies -b) cuts the data of the blocks into content-defined
+	chunks (see LZWDEDUP.C) and writes a chunk seen before in the input as a
+	REF block, a reference to its first copy, which the decoder copies back
+	from its own output: repeats much farther apart than any table reaches
+	cost a few bytes. The input must be a regular file (duplicates are
+	checked against it byte for byte), and so must the output of -d.
+	The chunks are cut and looked up on the main thread, in the order
+	of the input; the bytes between the references go to the pool.
+	
+	--crc adds CRC32C checksums (see LZWCRC.C): of the whole input, after the
+	last code, and in the block mode of each block, in its header. They are
+	taken at the buffer refills, on the bytes just read (compression) or
+	about to be written (decompression), or from the block in memory; the
+	CRC of a RUN block or a hole is computed from its length. The decoder
+	checks them.
+	
+	-t (test; or -v, verify) decodes without writing any output, into a
+	sink that only counts and checksums the bytes: no outputfile is given.
+	It reports success, or the output offset of the first error (the
+	block that fails its checksum, a bad code, ...). The exit status is 1
+	if the test fails, and so it is with -d if the decoding does. Under
+	-t, a REF block is not read back; its data was checked where it was
+	first written. The decoder rejects the codes that are not defined
+	yet, rather than decoding them.
+	
+	--index[=file] (with -d or -t) writes a seek index of the stream to file
+	(default inputfile.idx, see LZWIDX.H): the bit offset of each table and
+	the output offset where it starts. --range=off,len (with -d) then writes
+	only the len bytes of the output at offset off: the decoding starts at
+	the last table before off, and ends at the first one past the range.
+	A file of the block mode needs no index, as its block table serves
+	(but a range cannot take REF blocks of --dedup). Without an index or
+	a block table, the decoding starts at the start of the stream. A range
+	that ends past the end of the data is an error.
+	
+	A file may be several lzwhc files joined with cat (members, see
+	LZWHDR.H), each with its own settings; -d and -t decode them in turn.
+	The index and the block table of a range are those of the first one.
+	
+	--stats=json prints the statistics of the run (bytes, ratio, throughput,
+	peak RSS, segments, resets and the wall-clock time of each phase) on
+	stdout as one line of JSON. --perf reads the hardware performance
+	counters (LZWPERF.C) during the compression or decompression only,
+	its worker threads included.
+	--trace=file writes the I/O, reset, buffer and segment spans as a
+	Chrome trace (LZWTRACE.C; compile with -DLZW_TRACE).
+	--progress prints the rate, ratio so far and ETA every secs seconds
+	(default=1), and --status=file keeps them in file as JSON for a job
+	monitor (LZWPROG.C; link with -lpthread).
 
 	Version 1.1 - Optional dictionary table size (9/21/2022); single file codec.
+	Version 1.2 - Decoder phrase table: each code keeps its length and its last
+	              (up to 8) bytes packed in a word, so strings are written forward
+	              8 bytes at a time directly into the output buffer.
+	Version 1.3 - Decoder split into one loop per code size (9..28 bits), each
+	              generated with the code size as a constant.
+	Version 1.4 - Encoder split into stages: the matching kernel (LZWENC.C)
+	              turns a whole input buffer into an array of codes, which
+	              is then packed into bits.
+	Version 1.5 - Wall-clock timers for each phase (LZWRUN.C); --stats=json.
+	Version 1.6 - Hardware performance counters (LZWPERF.C); --perf.
+	Version 1.7 - Chrome trace of I/O, resets, buffers and segments
+	              (LZWTRACE.C); --trace=file.
+	Version 1.8 - Progress thread (LZWPROG.C); --progress, --status=file.
+	Version 1.9 - CLEAR mode (-a): ratio-driven table clears.
+	Version 2.0 - Max mode (-m): segments and code sizes picked by a parallel
+	              search (LZWMAX.C).
+	Version 2.1 - Code size and reset policy picked from a sample (LZWAUTO.C);
+	              --auto.
+	Version 2.2 - Block mode (-b): blocks that LZW would expand are stored
+	              raw, and copied back by the decoder.
+	Version 2.3 - Entropy pre-scan of the blocks (LZWSCAN.C); --no-scan.
+	Version 2.4 - RUN blocks for long runs of one byte; --no-runs.
+	Version 2.5 - Sparse files: input holes are not read, output holes
+	              are not written.
+	Version 2.6 - Deduplication of the blocks, REF blocks (LZWDEDUP.C); --dedup.
+	Version 2.7 - Portable file header with the uncompressed size and a
+	              table of the blocks (LZWHDR.C); old file stamps still read.
+	Version 2.8 - CRC32C checksums of the data and the blocks (LZWCRC.C);
+	              --crc, and -v to verify a file.
+	Version 2.9 - Test mode (-t): the output offset of the first error, and
+	              the exit status; undefined codes are errors.
+	Version 3.0 - Seek index of the tables (LZWIDX.C); --index, and --range to
+	              decode a part of the output.
+	Version 3.1 - Files of several members (cat a.lzw b.lzw > c.lzw).
+	Version 3.2 - Blocks coded by a pool of threads (LZWPOOL.C); --threads.
+	
+	Compile with -DLZW_STATS for the dictionary statistics of the encoder;
+	they are printed at the end, and during the run on SIGUSR1.
 	
 	Gerald R. Tamayo, 2005/2009/2022/2023
 */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "utypes.h"
-#include "gtbitio3.c"
+#include "lzwrun.c"
+#include "lzwperf.c"
+#include "lzwtrace.c"
+#include "lzwprog.c"
+#include "lzwmax.c"
+#include "lzwauto.c"
+#include "lzwscan.c"
+#include "lzwdedup.c"
+#include "lzwhdr.c"
+#include "lzwcrc.c"
+#include "lzwidx.c"
+#include "lzwpool.c"
 
-#define EOF_LZW_CODE     256
-#define LZW_NULL         256
-#define START_LZW_CODE   257
+/*
+	The file I/O and the table resets are timed as phases of their own;
+	the resets in the threads of the max mode search are not.
+*/
+static size_t timed_fread( void *p, size_t n, FILE *fp );
+static size_t timed_fwrite( const void *p, size_t n, FILE *fp );
+#define gt_fread( p, n, fp )   timed_fread( (p), (n), (fp) )
+#define gt_fwrite( p, n, fp )  timed_fwrite( (p), (n), (fp) )
+#define LZW_RESET_BEGIN()      if ( !max_worker ) { phase_switch( PHASE_RESET ); TRACE_BEGIN( "reset" ); }
+#define LZW_RESET_END()        if ( !max_worker ) { TRACE_END( "reset" ); phase_switch( PHASE_MATCH ); }
+
+#include "gtbitio3.c"
+#include "lzwenc.c"
 
 #define output_code(a,b) put_nbits((a), (b))
 
@@ -40,126 +196,295 @@ enum {
 	DECOMPRESS,
 };
 
-typedef struct {
-	char algorithm[4];
-	int code_max_bits;
-} file_stamp;
+/*
+	Files of lzwhc before version 2.7 start with a file stamp: "LZW"
+	and an int, the code size plus the mode bits below.
+*/
+#define STAMP_CLEAR_MODE   0x100
+#define STAMP_MAX_MODE     0x200
+#define STAMP_BLOCK_MODE   0x400
 
-/* code tables */
-int *code;
-int *prefix;
-unsigned char *character;
-unsigned char *stack_buffer, *stack=NULL;
+/*
+	The block mode (-b): after the header, each block of the input is
+	a header of BLOCK_HEADER_SIZE bytes (the type, then the input and
+	the stored sizes, 32-bit little-endian; with --crc, BLOCK_CRC_SIZE
+	more, the CRC32C of its input) and the stored bytes: the
+	block itself (BLOCK_RAW), its LZW codes with a table of its own,
+	ending with EOF_LZW_CODE and padded to a byte (BLOCK_LZW), or the
+	one byte repeated input size times (BLOCK_RUN, stored size 1), or
+	the 64-bit little-endian offset of an earlier copy of its input
+	size bytes in the output (BLOCK_REF, stored size 8). A BLOCK_END
+	byte ends the file.
+*/
+enum { BLOCK_RAW, BLOCK_LZW, BLOCK_RUN, BLOCK_REF, BLOCK_END = 0xff };
+#define BLOCK_HEADER_SIZE  9
+#define BLOCK_CRC_SIZE     4
+#define BLOCK_SIZE_KB      1024
+#define BLOCK_MAX_SIZE     (1<<30)
 
-int prefix_string_code = 0, lzw_code_cnt = 0;
-int old_lzw_code = 0, new_lzw_code = 0, lzwcode;
-int c = 0, code_max_bits = 16, /* default 65536 table size */
-	code_MAX, hash_TABLE_SIZE, hash_SHIFT;
+/*
+	Shortest run of one byte cut out into a RUN block: LZW takes some
+	90 codes for 4KB of one byte, and the data around the run loses
+	its table.
+*/
+#define BLOCK_RUN_MIN      (4<<10)
+#define BLOCK_RUN_MAX      0xffffffffu
 
-int bit_count = 9;  /* code size starts at 9 bits. */
-int code_max = 512; /* start expanding the code size if we
-                         already reached this value. */
+/* outputs at least this long are preallocated by the decoder. */
+#define PREALLOC_MIN       (1<<20)
 
-void copyright( void );
-void compress_LZW( void );
-void decompress_LZW( void );
+/* stored blocks at least this long are copied in the kernel if possible. */
+#define COPY_RANGE_MIN     (64<<10)
 
 /*
-	initialize the codes with a value of LZW_NULL,
-	indicating that the hash table slot is open.
+	The blocks are coded by a pool of threads (LZWPOOL.C); the tables
+	of the workers, and the input buffers whose blocks are not written
+	yet, take about BLOCK_POOL_MEM bytes at most. BLOCK_QUEUE blocks,
+	runs and references per input buffer may wait to be written.
 */
-void init_code_table( void )
+#define BLOCK_POOL_MEM     (256<<20)
+#define BLOCK_QUEUE        64
+
+/* the output of -v. */
+#if defined( _WIN32 )
+	#define NULL_DEVICE    "NUL"
+#else
+	#define NULL_DEVICE    "/dev/null"
+#endif
+
+/* the dictionary of the encoder, and its output codes. */
+#define NCODES   (1<<16)
+lzw_dict dict;
+uint32_t *codes;
+
+#if defined( LZW_STATS )
+/* set by SIGUSR1; checked after each input buffer. */
+volatile sig_atomic_t stats_requested = 0;
+#endif
+
+#if defined( LZW_STATS ) && defined( SIGUSR1 )
+static void request_stats( int sig )
 {
-    int i;
-    
-    for ( i = 0; i < hash_TABLE_SIZE; i++ ) {
-        code[ i ] = LZW_NULL;
-    }
+	stats_requested = 1;
+	signal( sig, request_stats );
 }
+#endif
+
+/* decoder phrase table (see insert_stringDEC()). */
+uint64_t *phrase_tail;
+int *phrase_len;
+int *phrase_back;
+
+int lzw_code_cnt = 0;
+int old_lzw_code = 0, first_char = 0;
+
+/* bit reservoir of the decoder; codes are taken from the low bits. */
+uint64_t dec_bitbuf = 0;
+int dec_bitcnt = 0;
+
+int code_max_bits = 16, /* default 65536 table size */
+	code_MAX;
+
+int bit_count = 9;  /* code size starts at 9 bits. */
+
+/* the CLEAR mode (-a), the max mode (-m), and the first code to define. */
+int clear_mode = 0, max_mode = 0, start_code = START_LZW_CODE;
+
+/*
+	The decoder stops at the codes 256 .. 256+nspecial-1: EOF_LZW_CODE,
+	and CLEAR_LZW_CODE in the CLEAR mode; stop_code is the one read.
+*/
+int nspecial = 1, stop_code = 0;
+
+/* string tables used by the encoder, and decoded. */
+int64_t enc_segments = 0, dec_segments = 0;
+
+/* the block mode (-b): block size, and the blocks stored raw and as LZW. */
+int block_mode = 0;
+int64_t block_size = (int64_t) BLOCK_SIZE_KB << 10;
+int64_t raw_blocks = 0, lzw_blocks = 0;
+
+/*
+	The threads of -m, --auto and the block mode (--threads; 0 = one
+	per processor), and the number that coded the blocks.
+*/
+int nthreads = 0, blk_threads = 1;
 
 /*
-	The insertion routine for the compressor, uses
-	hashing to store the codes in the code tables.
+	The entropy pre-scan of the blocks (LZWSCAN.C; off with --no-scan);
+	the input bytes stored raw, and those the pre-scan kept from LZW.
+*/
+int entropy_scan = 1;
+int64_t stored_bytes = 0, bypassed_bytes = 0;
+
+/* the RUN blocks (off with --no-runs), and the input bytes in them. */
+int find_runs = 1;
+int64_t run_blocks = 0, run_bytes = 0;
+
+/* the deduplication (--dedup): the REF blocks, and the input bytes in them. */
+int dedup = 0;
+int64_t ref_blocks = 0, ref_bytes = 0;
 
-	This function will always find an open slot, and
-	when it does, it immediately exits the function.
+/*
+	The checksums (--crc): the bytes read (crc_reads) or written
+	(crc_writes) at the buffer refills go into io_crc; data_crc is
+	that of the blocks so far. -t only tests (verify_only).
 */
-void insert_stringENC( int prefix_code, unsigned char c )
+int crc_mode = 0, crc_reads = 0, crc_writes = 0, verify_only = 0;
+uint32_t io_crc = 0, data_crc = 0;
+
+/* the errors of the decoder, and the output offset of the first one (-1: not known). */
+int64_t dec_errors = 0, first_error = -1;
+
+/* the output file of the encoder, removed if it fails (enc_fail). */
+const char *enc_out_name = NULL;
+
+/*
+	The seek index (--index, LZWIDX.H), made while decoding, and
+	--range=off,len: only the output bytes off..off+len-1 are written.
+	The decoding starts at the table (or block) before off; range_from
+	and range_to count from there, as range_pos does the bytes decoded.
+*/
+const char *index_name = NULL;
+int make_index = 0, range_mode = 0;
+lzw_index seg_index;
+int64_t range_off = 0, range_len = 0, range_from = 0, range_to = 0, range_pos = 0;
+
+/* where decompress_LZW() starts a range: bits to skip, and the state of the index entry. */
+int dec_skip_bits = 0, dec_state = 0;
+
+/*
+	The members of the input (files joined with cat): how many were
+	decoded, how many had checksums, and the CRC32C of their output so
+	far; member_out is where the output of the current one starts.
+*/
+int members = 0, crc_members = 0;
+int64_t member_out = 0;
+uint32_t all_crc = 0;
+
+/* nonzero while the decoder reads an LZW block from memory. */
+int dec_in_block = 0;
+
+/* the file header (LZWHDR.H). */
+lzw_header fhdr;
+
+/* the block table: the input and file offsets of each block written. */
+int64_t *blk_table = NULL;
+size_t blk_table_n = 0, blk_table_cap = 0;
+int64_t blk_in_off = 0;
+
+/* codes written (compression) or read (decompression). */
+int64_t ncodes = 0;
+
+void copyright( void );
+void compress_LZW( void );
+void compress_max( int64_t size );
+void compress_blocks( void );
+void decompress_blocks( void );
+static void put_block_table( void );
+static void put_data_crc( void );
+static void check_data_crc( void );
+static void dec_error( int64_t off );
+static void enc_fail( const char *what );
+static int64_t range_seek( int64_t start, int64_t file_size );
+static int64_t get_le32( const unsigned char *p );
+static int member_mode( const char *name );
+static int alloc_phrase_table( void );
+static int64_t member_end( void );
+static int refill_at( int64_t off );
+static inline int range_done( void );
+void decompress_LZW( void );
+static void preallocate_output( void );
+
+/*
+	The decompression part does not actually need hashing.
+
+	Instead of the prefix code and the append character, each code
+	stores its string length and the string's last "chunk" (1..8 bytes,
+	in memory order) in a 64-bit word. phrase_back[] is the code of the
+	string minus that last chunk (whose length is a multiple of 8), or
+	-1 if the string is only one chunk long.
+*/
+void init_phrase_table( void )
 {
-	int hindex;       /* the hashed index address. */
-	int d;            /* the "displacement" to compute for the new index. */
+	int i;
 	
-	/* first probe is the hash function itself. */
-	hindex = (c << hash_SHIFT) ^ prefix_code;
-
-	/* prepare for the second probe. */
-	d = hash_TABLE_SIZE - hindex;
-	if ( hindex == 0 ) d = 1;
+	for ( i = 0; i < 256; i++ ) {
+		phrase_tail[ i ] = 0;
+		*((unsigned char *) &phrase_tail[ i ]) = (unsigned char) i;
+		phrase_len[ i ] = 1;
+		phrase_back[ i ] = -1;
+	}
+}
 
-	do {
-		/* available slot; store code here. */
-		if ( code[ hindex ] == LZW_NULL ) {
-			code[ hindex ] = lzw_code_cnt;
-			prefix[ hindex ] = prefix_code;
-			character[ hindex ] = c;
-			return ;
-		}
-		/* otherwise, do a second probe. */
-		if ( (hindex -= d) < 0 )
-			hindex += hash_TABLE_SIZE;
-	} while( 1 );
+static inline void insert_stringDEC( int lzwcode, int prefix_code, unsigned char c )
+{
+	int r = phrase_len[ prefix_code ] & 7;  /* bytes in the last chunk. */
+	
+	if ( r == 0 ) { /* last chunk is full; start a new one. */
+		phrase_tail[ lzwcode ] = 0;
+		phrase_back[ lzwcode ] = prefix_code;
+	}
+	else {
+		phrase_tail[ lzwcode ] = phrase_tail[ prefix_code ];
+		phrase_back[ lzwcode ] = phrase_back[ prefix_code ];
+	}
+	((unsigned char *) &phrase_tail[ lzwcode ])[ r ] = c;
+	phrase_len[ lzwcode ] = phrase_len[ prefix_code ] + 1;
 }
 
 /*
-	The decompression part does not actually need hashing,
-	so just store the prefix codes and the append characters.
+	Writes the string of lzwcode at p, last chunk first, 8 bytes
+	per step. Up to 7 bytes past the end of the string are clobbered.
 */
-void insert_stringDEC( int prefix_code, unsigned char c )
+static inline void write_phrase( unsigned char *p, int lzwcode )
 {
-	prefix[ lzw_code_cnt ] = prefix_code;
-	character[ lzw_code_cnt ] = c;
+	p += (phrase_len[ lzwcode ]-1) & ~7;
+	memcpy( p, &phrase_tail[ lzwcode ], 8 );
+	while ( (lzwcode = phrase_back[ lzwcode ]) >= 0 ) {
+		p -= 8;
+		memcpy( p, &phrase_tail[ lzwcode ], 8 );
+	}
 }
 
 /*
-	Search for the string composed of a prefix code
-	and a character.
+	Outputs the string of lzwcode and returns its first character.
+	The string goes straight into the output buffer.
 */
-int search_string( int prefix_code, unsigned char c )
+static inline int output_phrase( int lzwcode )
 {
-	int hindex;       /* the hashed index address. */
-	int d;            /* the "displacement" to compute for the new index. */
-	
-	hindex = (c << hash_SHIFT) ^ prefix_code;
-
-	if ( hindex == 0 ) d = 1;
-	else d = hash_TABLE_SIZE - hindex;
+	int len = phrase_len[ lzwcode ];
+	unsigned char *p = pfreserve( len+8 );
 	
-	do {
-		/* empty slot; code pair not found. */
-		if ( code[ hindex ] == LZW_NULL ) break;
-		
-		/* a code pair is stored here, so check it. */
-		if (	prefix[ hindex ] == prefix_code
-					&& character[ hindex ] == c ) { /* a match! */
-			
-			/* copy the code and return success. */
-			prefix_string_code = code[ hindex ];
-			return 1;
-		}
-		
-		/* second probe; find another available slot. */
-		if ( (hindex -= d) < 0 )
-			hindex += hash_TABLE_SIZE;
-	} while( 1 );
-	
-	return 0;
+	write_phrase( p, lzwcode );
+	pfcommit( len );
+	return *p;
 }
 
 void usage( void )
 {
-    fprintf(stderr, "\n Usage: lzwhc [-c[N]] [-d] infile outfile");
+    fprintf(stderr, "\n Usage: lzwhc [-c[N]] [-a|-m|--auto[=obj]] [-b[K]] [--dedup] [--no-scan] [--no-runs]");
+    fprintf(stderr, "\n              [--threads=n] [--crc] [-d|-t] [--index[=file]] [--range=off,len] [--stats=json]");
+    fprintf(stderr, "\n              [--perf] [--trace=file] [--progress[=secs]] [--status=file] infile outfile");
     fprintf(stderr, "\n\n Options:\n\n  c[N] = compress, where N = bitsize of dictionary table size CODE_MAX (default=16); N=12..28.");
-    fprintf(stderr, "\n  d = decompress.\n");
+    fprintf(stderr, "\n  a = compress with CLEAR codes when the ratio drops.");
+    fprintf(stderr, "\n  m = compress with the best segments and table sizes up to N (slow).");
+    fprintf(stderr, "\n  --auto[=obj] = pick N and a from a sample; obj = balanced, ratio or speed.");
+    fprintf(stderr, "\n  b[K] = compress in blocks of K KB (default=1024); store the incompressible ones.");
+    fprintf(stderr, "\n  --dedup = blocks, with repeated chunks of the input stored as references.");
+    fprintf(stderr, "\n  --no-scan = in blocks, run LZW even on blocks that look random.");
+    fprintf(stderr, "\n  --no-runs = in blocks, leave long runs of one byte to LZW.");
+    fprintf(stderr, "\n  --threads=n = n threads for m, --auto and the blocks (default=one per processor).");
+    fprintf(stderr, "\n  --crc = add CRC32C checksums of the data (and of each block).");
+    fprintf(stderr, "\n  d = decompress.");
+    fprintf(stderr, "\n  t = test (or v, verify): decompress and check, with no outfile.");
+    fprintf(stderr, "\n  --index[=file] = also write the seek index of infile (default infile.idx).");
+    fprintf(stderr, "\n  --range=off,len = decompress only the len bytes at offset off, with the index.");
+    fprintf(stderr, "\n  --stats=json = print the run statistics as JSON on stdout.");
+    fprintf(stderr, "\n  --perf = report the hardware performance counters.");
+    fprintf(stderr, "\n  --trace=file = write a Chrome trace of the run to file.");
+    fprintf(stderr, "\n  --progress[=secs] = print the progress every secs seconds (default=1).");
+    fprintf(stderr, "\n  --status=file = keep the progress in file as JSON.\n");
     copyright();
     exit (0);
 }
@@ -167,32 +492,125 @@ void usage( void )
 int main( int argc, char *argv[] )
 {
 	float ratio = 0.0;
-	file_stamp fstamp;
 	int mode = -1, in_argn = 0, out_argn = 0, fcount = 0, n;
+	int stats_json = 0, use_perf = 0, show_progress = 0;
+	int auto_obj = -1, bits_given = 0;
+	auto_setting best;
+	double progress_interval = 1.0;
+	const char *status_file = NULL, *out_name = NULL;
+	int64_t total_in, start;
+	long long roff, rlen;
+	run_stats rs;
+	double secs;
 	
-	clock_t start_time = clock();
+	run_start();
+	memset( &rs, 0, sizeof(rs) );
 	init_buffer_sizes( 1<<20 );
+#if defined( LZW_STATS ) && defined( SIGUSR1 )
+	signal( SIGUSR1, request_stats );
+#endif
 	
 	/* command-line handler */
-	if ( argc < 3 || argc > 4 ) usage();
-	else if ( argc == 3 ) mode = COMPRESS;
+	if ( argc < 3 ) usage();
 	n = 1;
 	while ( n < argc ){
-		if ( argv[n][0] == '-' ){
+		if ( argv[n][0] == '-' && argv[n][1] == '-' ){
+			if ( strcmp( argv[n], "--stats=json" ) == 0 ) stats_json = 1;
+			else if ( strcmp( argv[n], "--perf" ) == 0 ) use_perf = 1;
+			else if ( strncmp( argv[n], "--trace=", 8 ) == 0 && argv[n][8] ) {
+				if ( trace_open( &argv[n][8] ) ) trace_thread_name( "main" );
+			}
+			else if ( strncmp( argv[n], "--progress", 10 ) == 0 ) {
+				show_progress = 1;
+				if ( argv[n][10] == '=' ) progress_interval = atof( &argv[n][11] );
+				else if ( argv[n][10] != 0 ) usage();
+				if ( progress_interval <= 0 ) usage();
+			}
+			else if ( strncmp( argv[n], "--status=", 9 ) == 0 && argv[n][9] ) {
+				status_file = &argv[n][9];
+			}
+			else if ( strncmp( argv[n], "--threads=", 10 ) == 0 ) {
+				if ( (nthreads = atoi( &argv[n][10] )) < 1 ) usage();
+			}
+			else if ( strcmp( argv[n], "--no-scan" ) == 0 ) entropy_scan = 0;
+			else if ( strcmp( argv[n], "--no-runs" ) == 0 ) find_runs = 0;
+			else if ( strncmp( argv[n], "--index", 7 ) == 0 ) {
+				if ( argv[n][7] == '=' && argv[n][8] ) index_name = &argv[n][8];
+				else if ( argv[n][7] != 0 ) usage();
+				if ( mode == COMPRESS ) usage();
+				mode = DECOMPRESS;
+				make_index = 1;
+			}
+			else if ( strncmp( argv[n], "--range=", 8 ) == 0 ) {
+				if ( sscanf( &argv[n][8], "%lld,%lld", &roff, &rlen ) != 2 || roff < 0 || rlen < 0
+					|| mode == COMPRESS || verify_only ) usage();
+				mode = DECOMPRESS;
+				range_mode = 1;
+				range_off = roff;
+				range_len = rlen;
+			}
+			else if ( strcmp( argv[n], "--crc" ) == 0 ) {
+				if ( mode == DECOMPRESS ) usage();
+				mode = COMPRESS;
+				crc_mode = 1;
+			}
+			else if ( strcmp( argv[n], "--dedup" ) == 0 ) {
+				if ( mode == DECOMPRESS || max_mode ) usage();
+				mode = COMPRESS;
+				block_mode = 1;
+				dedup = 1;
+			}
+			else if ( strncmp( argv[n], "--auto", 6 ) == 0 ) {
+				if ( argv[n][6] == 0 || strcmp( &argv[n][6], "=balanced" ) == 0 ) auto_obj = AUTO_BALANCED;
+				else if ( strcmp( &argv[n][6], "=ratio" ) == 0 ) auto_obj = AUTO_RATIO;
+				else if ( strcmp( &argv[n][6], "=speed" ) == 0 ) auto_obj = AUTO_SPEED;
+				else usage();
+				if ( mode == DECOMPRESS || clear_mode || max_mode ) usage();
+				mode = COMPRESS;
+			}
+			else usage();
+		}
+		else if ( argv[n][0] == '-' ){
 			switch( tolower(argv[n][1]) ){
 				case 'c':
 					if ( argv[n][2] != 0 ){
 						code_max_bits = atoi(&argv[n][2]);
 						if ( code_max_bits < 12 ) usage();   /* smallest table size 4096 */
 						else if ( code_max_bits > 28 ) usage();
+						bits_given = 1;
 					}
 					if ( mode == DECOMPRESS ) usage();
 					else mode = COMPRESS;
 					break;
+				case 'a':
+					if ( argv[n][2] != 0 || mode == DECOMPRESS || max_mode || auto_obj >= 0 ) usage();
+					mode = COMPRESS;
+					clear_mode = 1;
+					break;
+				case 'm':
+					if ( argv[n][2] != 0 || mode == DECOMPRESS || clear_mode || auto_obj >= 0 || block_mode ) usage();
+					mode = COMPRESS;
+					max_mode = 1;
+					break;
+				case 'b':
+					if ( argv[n][2] != 0 ) {
+						block_size = (int64_t) atoi( &argv[n][2] ) << 10;
+						if ( block_size < 1024 || block_size > BLOCK_MAX_SIZE ) usage();
+					}
+					if ( mode == DECOMPRESS || max_mode ) usage();
+					mode = COMPRESS;
+					block_mode = 1;
+					break;
 				case 'd':
 					if ( argv[n][2] != 0 || mode == COMPRESS ) usage();
 					mode = DECOMPRESS;
 					break;
+				case 't':
+				case 'v':
+					if ( argv[n][2] != 0 || mode == COMPRESS || range_mode ) usage();
+					mode = DECOMPRESS;
+					verify_only = 1;
+					break;
 				default: usage();
 			}
 		}
@@ -203,107 +621,239 @@ int main( int argc, char *argv[] )
 		}
 		++n;
 	}
-	if ( in_argn == 0 || out_argn == 0 ) usage();
+	if ( in_argn == 0 || (out_argn == 0) != verify_only ) usage();
+	if ( mode == -1 ) mode = COMPRESS;
+	out_name = verify_only ? NULL_DEVICE : argv[out_argn];
+	if ( (make_index || range_mode) && !index_name ) {
+		/* the default index: infile.idx */
+		if ( (index_name = (char *) malloc( strlen( argv[in_argn] ) + 5 )) == NULL ) usage();
+		sprintf( (char *) index_name, "%s.idx", argv[in_argn] );
+	}
+	if ( range_mode ) make_index = 0;  /* (the index is read.) */
 	
 	/* Open input and output files. */
 	if ( (gIN = fopen( argv[in_argn], "rb" )) == NULL ) {
 		fprintf(stderr, "\nError opening input file, %s.", argv[in_argn] );
-		return 0;
+		return 1;
 	}
-	if ( (pOUT = fopen( argv[out_argn], "wb" )) == NULL ) {
-		fprintf(stderr, "\nError opening output file, %s.", argv[out_argn] );
-		return 0;
+	/* the decoder of --dedup reads back its output. */
+	if ( mode == DECOMPRESS && !verify_only ) pOUT = fopen( out_name, "w+b" );
+	if ( pOUT == NULL && (pOUT = fopen( out_name, "wb" )) == NULL ) {
+		fprintf(stderr, "\nError opening output file, %s.", out_name );
+		return 1;
 	}
+	if ( mode == COMPRESS ) enc_out_name = out_name;
 	
-	/* test file length. */
-	if ( fgetc(gIN) == EOF ) return 0;  /* file length = 0. */
-	else rewind(gIN);
+	/* test file length (an empty input still gets a header; an empty file does not decode). */
+	if ( fgetc(gIN) == EOF && mode == DECOMPRESS ) {
+		fprintf(stderr, "\nError: %s is empty, not an lzwhc file.", argv[in_argn] );
+		return 1;
+	}
+	fseek( gIN, 0, SEEK_END );
+	total_in = ftell( gIN );
+	rewind( gIN );
 	init_put_buffer();
 	
+	/* --auto: the code size and the reset policy from a sample. */
+	if ( auto_obj >= 0 ) {
+		phase_switch( PHASE_SEARCH );
+		TRACE_BEGIN( "auto" );
+		n = (int) auto_tune( gIN, total_in, bits_given ? code_max_bits : 20, auto_obj, nthreads, &best );
+		TRACE_END( "auto" );
+		phase_switch( PHASE_OTHER );
+		if ( n ) {
+			code_max_bits = best.code_max_bits;
+			clear_mode = best.clear;
+			fprintf(stderr, "\nAuto setting           = -c%d%s (sample of %d bytes: ratio %.4f, %.2f MB/s)",
+				code_max_bits, clear_mode ? " -a" : "", n, best.ratio, best.mb_per_s );
+		}
+		else fprintf(stderr, "\nAuto setting failed; using -c%d.", code_max_bits );
+	}
+	
 	/* If DECOMPRESS mode, read input file and get code_max_bits. */
 	if ( mode == DECOMPRESS ) {
-		/* Read file stamp to get code_max_bits. */
-		fread( &fstamp, sizeof(file_stamp), 1, gIN );
-		code_max_bits = fstamp.code_max_bits;
+		/* Read the header (or the old file stamp) to get code_max_bits. */
+		if ( !(n = hdr_read( gIN, &fhdr, 1 )) ) {
+			fprintf(stderr, "\nError: %s is not an lzwhc file.", argv[in_argn] );
+			dec_error( 0 );
+			goto halt_prog;
+		}
+		if ( !member_mode( argv[in_argn] ) ) goto halt_prog;
+		start = n;
+		if ( range_mode ) {
+			if ( (start = range_seek( n, total_in )) < 0 ) {
+				dec_error( 0 );
+				goto halt_prog;
+			}
+		}
+		else preallocate_output();
 		init_get_buffer();
-		nbytes_read = sizeof(file_stamp);
-	}
-	
-	/* Set hash_TABLE_SIZE, hash_SHIFT, and code_MAX. */
-	switch ( code_max_bits ) {
-		case 12: hash_TABLE_SIZE =      5021; break;
-		case 13: hash_TABLE_SIZE =      9859; break;
-		case 14: hash_TABLE_SIZE =     18041; break;
-		case 15: hash_TABLE_SIZE =     35023; break;
-		case 16: hash_TABLE_SIZE =     69001; break;
-		case 17: hash_TABLE_SIZE =    134989; break;
-		case 18: hash_TABLE_SIZE =    279991; break;
-		case 19: hash_TABLE_SIZE =    539881; break;
-		case 20: hash_TABLE_SIZE =   1249943; break;
-		case 21: hash_TABLE_SIZE =   2157151; break;
-		case 22: hash_TABLE_SIZE =   4225303; break;
-		case 23: hash_TABLE_SIZE =   8500249; break;
-		case 24: hash_TABLE_SIZE =  16795123; break;
-		case 25: hash_TABLE_SIZE =  33559021; break;
-		case 26: hash_TABLE_SIZE =  67125433; break;
-		case 27: hash_TABLE_SIZE = 134253857; break;
-		case 28: hash_TABLE_SIZE = 268470641; break;
-		default: break;
-	}
-	hash_SHIFT = code_max_bits - 8;
+		nbytes_read = start;
+		progress_in( start );
+	}
+	
 	code_MAX = 1 << code_max_bits;
+	if ( clear_mode || max_mode ) {
+		start_code = CLEAR_LZW_CODE + 1;
+		nspecial = 2;
+	}
 	
 	/* Allocate memory for the code tables. */
 	if ( mode == COMPRESS ){
-		code = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
-		if ( !code ) {
-			fprintf(stderr, "\n Error alloc: code buffer.");
-			goto halt_prog;
-		}
+		/* the max mode allocates a table for each code size it uses. */
+		if ( !max_mode && !lzw_dict_alloc( &dict, code_max_bits ) )
+			enc_fail( "code tables" );
+		if ( clear_mode ) lzw_dict_use_clear( &dict );
+		codes = (uint32_t *) malloc( sizeof(uint32_t) * NCODES );
+		if ( !codes ) enc_fail( "code array" );
 	}
 	else if ( mode == DECOMPRESS ){
-		/* allocate memory for the stack buffer. */
-		stack_buffer = (unsigned char *) malloc( sizeof(unsigned char) * code_MAX );
-		if ( !stack_buffer ) {
-			fprintf(stderr, "\n Error alloc: stack buffer.");
-			goto halt_prog;
-		}
-	}
-	prefix = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
-	if ( !prefix ) {
-		fprintf(stderr, "\n Error alloc: prefix buffer.");
-		goto halt_prog;
-	}
-	character = (unsigned char *) malloc( sizeof(unsigned char) * hash_TABLE_SIZE );
-	if ( !character ) {
-		fprintf(stderr, "\n Error alloc: character buffer.");
-		goto halt_prog;
+		/* allocate memory for the phrase table. */
+		if ( !alloc_phrase_table() ) goto halt_prog;
 	}
 	
 	/* Finally, compress or decompress input file. */
+	if ( show_progress || status_file ) {
+		if ( !progress_start( progress_interval, show_progress, status_file, total_in ) )
+			fprintf(stderr, "\nCannot start the progress thread.");
+	}
 	if ( mode == COMPRESS ){
+		/* the blocks take their checksums in memory. */
+		crc_reads = crc_mode && !block_mode;
 		init_get_buffer();
-		/* Write the FILE STAMP. */
-		strcpy( fstamp.algorithm, "LZW" );
-		fstamp.code_max_bits = code_max_bits;
-		fwrite( &fstamp, sizeof(file_stamp), 1, pOUT );
-		nbytes_out = sizeof(file_stamp);
+		/* Write the header (see LZWHDR.H). */
+		hdr_init( &fhdr, HDR_LZWHC, clear_mode ? HDR_RESET_CLEAR
+			: max_mode ? HDR_RESET_SEGMENTS : HDR_RESET_BLIND, code_max_bits, gIN );
+		if ( block_mode ) fhdr.flags |= HDR_BLOCKS;
+		if ( crc_mode ) fhdr.flags |= HDR_CRC;
+		nbytes_out = hdr_write( pOUT, &fhdr );
+		progress_out( nbytes_out );
 		
 		fprintf(stderr, "\nDictionary size used   = %15lu codes", (ulong) code_MAX );
 		
-		fprintf(stderr, "\n\nLZW Encoding [ %s to %s ] ...", argv[in_argn], argv[out_argn] );
-		compress_LZW();
+		if ( use_perf ) perf_open();
+		fprintf(stderr, "\n\nLZW Encoding [ %s to %s ] ...", argv[in_argn], out_name );
+		perf_start();
+		if ( max_mode ) compress_max( total_in );
+		else if ( block_mode ) compress_blocks();
+		else compress_LZW();
+		if ( crc_mode ) put_data_crc();
+		if ( block_mode ) put_block_table();
+		perf_stop();
 	}
 	else if ( mode == DECOMPRESS ){
-		fprintf(stderr, "\nLZW Decoding...");
-		decompress_LZW();
+		if ( use_perf ) perf_open();
+		fprintf(stderr, verify_only ? "\nLZW Testing..." : "\nLZW Decoding...");
+		perf_start();
+		while ( 1 ) {
+			if ( block_mode ) decompress_blocks();
+			else decompress_LZW();
+			flush_put_buffer();
+			/* (after an error, the checksum may not be where it is read.) */
+			if ( crc_writes && !dec_errors ) check_data_crc();
+			if ( !range_mode && !hdr_check_size( &fhdr, nbytes_out - member_out ) ) {
+				dec_error( member_out + ((int64_t) fhdr.size < nbytes_out - member_out
+					? (int64_t) fhdr.size : nbytes_out - member_out) );
+			}
+			members++;
+			if ( crc_mode ) {
+				crc_members++;
+				all_crc = crc32c_combine( all_crc, data_crc, nbytes_out - member_out );
+			}
+			
+			/* the next member, if any (the member ends where the next header starts). */
+			if ( dec_errors || range_done() || fhdr.legacy ) break;
+			start = member_end();
+			if ( (n = hdr_next_member( gIN, start, &fhdr )) <= 0 ) {
+				if ( n < 0 ) fprintf(stderr, "\nWarning: %lld bytes after the last member, ignored.",
+					(long long) (total_in - start) );
+				break;
+			}
+			if ( !member_mode( argv[in_argn] ) || !alloc_phrase_table() ) break;
+			member_out = nbytes_out;
+			io_crc = data_crc = 0;
+			refill_at( start + n );
+		}
+		perf_stop();
+		/* the data ends before the range does. */
+		if ( range_mode && !dec_errors && nbytes_out < range_to ) {
+			fprintf(stderr, "\nError: the range %lld,%lld is past the end of the data (%lld bytes).",
+				(long long) range_off, (long long) range_len, (long long) (range_off - range_from + nbytes_out) );
+			dec_error( nbytes_out );
+		}
 	}
 	flush_put_buffer();
+	progress_stop();
 	nbytes_read = get_nbytes_read();
+	if ( mode == COMPRESS && (!(fhdr.flags & HDR_SIZE) || (fhdr.flags & HDR_TABLE)) ) {
+		/* the size of an input that was not a file, and the block table. */
+		fhdr.size = nbytes_read;
+		fhdr.flags |= HDR_SIZE;
+		hdr_rewrite( pOUT, &fhdr );
+	}
+	if ( make_index ) {
+		if ( block_mode ) fprintf(stderr, "\nNo index for a file of blocks: its block table serves.");
+		else if ( members > 1 ) fprintf(stderr, "\nNo index for a file of several members.");
+		else if ( dec_errors ) fprintf(stderr, "\nNo index written: the decoding failed.");
+		else {
+			seg_index.file_size = total_in;
+			seg_index.data_size = nbytes_out;
+			if ( idx_write( index_name, &seg_index ) ) fprintf(stderr, "\nIndex: %lld tables, in %s.",
+				(long long) seg_index.n, index_name );
+			else fprintf(stderr, "\nError writing the index, %s.", index_name );
+		}
+		idx_free( &seg_index );
+	}
 	
 	fprintf(stderr, "done.\n %s (%lld) -> %s (%lld)", 
-		argv[in_argn], nbytes_read, argv[out_argn], nbytes_out);	
+		argv[in_argn], nbytes_read, out_name, nbytes_out);	
+	if ( mode == DECOMPRESS && dec_errors ) {
+		fprintf(stderr, "\n%s: FAILED, %lld error%s", verify_only ? "Test" : "Decoding",
+			(long long) dec_errors, dec_errors > 1 ? "s" : "" );
+		if ( first_error >= 0 ) fprintf(stderr, "; the first at output byte %lld.", (long long) first_error );
+		else fprintf(stderr, "; the data fails its checksum.");
+	}
+	else if ( range_mode ) {
+		range_pos = range_pos < range_to ? range_pos : range_to;
+		fprintf(stderr, "\nRange: %lld bytes at output byte %lld (%lld decoded from byte %lld).",
+			(long long) (range_pos > range_from ? range_pos - range_from : 0), (long long) range_off,
+			(long long) nbytes_out, (long long) (range_off - range_from) );
+	}
+	else if ( mode == DECOMPRESS && (crc_members || verify_only) ) {
+		fprintf(stderr, "\n%s: ok", verify_only ? "Test" : "Checksums" );
+		if ( crc_members == members ) fprintf(stderr, " (CRC32C %08x).", (unsigned) all_crc );
+		else if ( crc_members ) fprintf(stderr, " (%d of the %d members with checksums).", crc_members, members );
+		else fprintf(stderr, " (no checksums in the file: decoded only).");
+	}
+	if ( members > 1 ) fprintf(stderr, "\nMembers: %d.", members );
+	
+	rs.tool = "lzwhc";
+	rs.bytes_in = nbytes_read;
+	rs.bytes_out = nbytes_out;
+	rs.code_max_bits = code_max_bits;
+	if ( mode == COMPRESS ) {
+		rs.mode = "compress";
+		rs.segments = enc_segments;
+	}
+	else {
+		rs.mode = "decompress";
+		rs.segments = dec_segments;
+	}
+	rs.resets = rs.segments ? rs.segments - 1 : 0;
+	rs.bytes_stored = stored_bytes;
+	rs.bytes_bypassed = bypassed_bytes;
+	rs.bytes_run = run_bytes;
+	rs.bytes_deduped = ref_bytes;
+	
 	if ( mode == COMPRESS ) {
+		if ( block_mode ) fprintf(stderr, "\nBlocks: %lld LZW, %lld stored raw"
+			" (%lld bytes, %lld of them not run through LZW), %lld runs (%lld bytes)",
+			(long long) lzw_blocks, (long long) raw_blocks,
+			(long long) stored_bytes, (long long) bypassed_bytes,
+			(long long) run_blocks, (long long) run_bytes );
+		if ( ref_blocks ) fprintf(stderr, "\nDedup: %lld references (%lld bytes)",
+			(long long) ref_blocks, (long long) ref_bytes );
+		if ( block_mode ) fprintf(stderr, "\nBlock threads: %d", blk_threads );
 		ratio = (((float) nbytes_read - (float) nbytes_out) /
 			(float) nbytes_read ) * (float) 100;
 		fprintf(stderr, "\nCompression ratio: %3.2f %%", ratio );
@@ -311,19 +861,28 @@ int main( int argc, char *argv[] )
 	
 	halt_prog:
 	
+	phase_switch( PHASE_FREE );
 	free_put_buffer();
 	free_get_buffer();
-	if ( code ) free( code );
-	if ( prefix ) free( prefix );
-	if ( character ) free( character );
-	if ( stack_buffer ) free( stack_buffer );
+	lzw_dict_free( &dict );
+	if ( codes ) free( codes );
+	if ( phrase_tail ) free( phrase_tail );
+	if ( phrase_len ) free( phrase_len );
+	if ( phrase_back ) free( phrase_back );
 	if ( gIN ) fclose( gIN );
 	if ( pOUT ) fclose( pOUT );
+	phase_switch( PHASE_OTHER );
 	
 	if ( mode == DECOMPRESS ) nbytes_read = nbytes_out;
+	secs = run_time();
 	fprintf(stderr, " in %3.2f secs (@ %3.2f MB/s)\n",
-		(double)(clock()-start_time)/CLOCKS_PER_SEC, (nbytes_read/1048576)/((double)(clock()-start_time)/CLOCKS_PER_SEC) );
-	return 0;
+		secs, secs > 0 ? (nbytes_read / 1048576.0) / secs : 0.0 );
+	if ( use_perf && rs.mode ) {
+		perf_report( stderr, rs.mode, rs.bytes_in, ncodes );
+		perf_close();
+	}
+	if ( stats_json && rs.mode ) run_json( stdout, &rs );
+	return dec_errors != 0;
 }
 
 void copyright( void )
@@ -331,116 +890,1398 @@ void copyright( void )
 	fprintf(stderr, "\n :: Gerald R. Tamayo (c) 2005-2023\n");
 }
 
+static size_t timed_fread( void *p, size_t n, FILE *fp )
+{
+	int prev = phase_switch( PHASE_READ );
+	size_t nread;
+	
+	TRACE_BEGIN( "read" );
+	nread = fread( p, 1, n, fp );
+	TRACE_END( "read" );
+	progress_in( nread );
+	if ( crc_reads ) {
+		phase_switch( PHASE_CHECK );
+		io_crc = crc32c( io_crc, p, nread );
+	}
+	phase_switch( prev );
+	return nread;
+}
+
+static size_t timed_fwrite( const void *p, size_t n, FILE *fp )
+{
+	int prev;
+	size_t nwritten = 1;
+	
+	if ( crc_writes ) {
+		prev = phase_switch( PHASE_CHECK );
+		io_crc = crc32c( io_crc, p, n );
+		phase_switch( PHASE_WRITE );
+	}
+	else prev = phase_switch( PHASE_WRITE );
+	TRACE_BEGIN( "write" );
+	if ( range_mode ) {
+		/* only the bytes of the range are written. */
+		int64_t lo = range_from - range_pos, hi = range_to - range_pos;
+		
+		if ( lo < 0 ) lo = 0;
+		if ( hi > (int64_t) n ) hi = n;
+		range_pos += n;
+		if ( hi > lo ) nwritten = fwrite( (const unsigned char *) p + lo, hi - lo, 1, fp );
+	}
+	else if ( !verify_only ) nwritten = fwrite( p, n, 1, fp );
+	TRACE_END( "write" );
+	progress_out( n );
+	phase_switch( prev );
+	return nwritten;
+}
+
+/* The packing stage: writes the code array as variable-length codes. */
+static void pack_codes( const uint32_t *p, size_t n )
+{
+	while ( n-- ) {
+		if ( *p & LZW_WIDTH_MARK ) bit_count = *p & 0xff;
+		else {
+			output_code( *p, bit_count );
+			ncodes++;
+		}
+		p++;
+	}
+}
+
+/* fills the input buffer again; returns 0 at end of file (or of a block). */
+static int refill_gbuf( void )
+{
+	if ( dec_in_block ) return 0;
+	nbytes_read += nfread;
+	gbuf = gbuf_start;
+	nfread = gt_fread( gbuf, gBUFSIZE, gIN );
+	gbuf_end = (unsigned char *) (gbuf + nfread);
+	return nfread;
+}
+
+/* copies up to n input bytes to p; returns the number copied. */
+static int64_t get_bytes( unsigned char *p, int64_t n )
+{
+	int64_t got = 0, k;
+	
+	while ( got < n ) {
+		if ( gbuf == gbuf_end && !refill_gbuf() ) break;
+		k = gbuf_end - gbuf;
+		if ( k > n - got ) k = n - got;
+		memcpy( p + got, gbuf, k );
+		gbuf += k;
+		got += k;
+	}
+	return got;
+}
+
+/*
+	The encoder is out of memory (for what): the output is not a whole
+	file, so it is removed (if it is a regular file), and the exit
+	status is 1.
+*/
+static void enc_fail( const char *what )
+{
+	struct stat st;
+	int regular = pOUT && fstat( fileno( pOUT ), &st ) == 0 && S_ISREG( st.st_mode );
+	
+	fprintf(stderr, "\n Error alloc: %s.", what );
+	if ( pOUT ) fclose( pOUT );
+	if ( regular && enc_out_name ) remove( enc_out_name );
+	exit( 1 );
+}
+
+/* notes an error of the decoder at output offset off (-1: not known). */
+static void dec_error( int64_t off )
+{
+	/* (a range counts from where its decoding started.) */
+	if ( dec_errors++ == 0 ) first_error = off >= 0 && range_mode ? off + range_off - range_from : off;
+}
+
+/* --range: the bytes decoded (written or in the output buffer) reach the end of the range. */
+static inline int range_done( void )
+{
+	return range_mode && !dec_in_block && nbytes_out + pbuf_count >= range_to;
+}
+
+/* reads entry i of the block table: the input and the file offsets of the block. */
+static int read_table_entry( uint32_t i, int64_t *in_off, int64_t *file_off )
+{
+	unsigned char b[ HDR_TABLE_ENTRY ];
+	
+	if ( fseeko( gIN, (off_t) (fhdr.table_off + (uint64_t) i * HDR_TABLE_ENTRY), SEEK_SET ) != 0
+		|| fread( b, HDR_TABLE_ENTRY, 1, gIN ) != 1 ) return 0;
+	*in_off = get_le32( b ) | get_le32( b+4 ) << 32;
+	*file_off = get_le32( b+8 ) | get_le32( b+12 ) << 32;
+	return 1;
+}
+
+/*
+	--range: finds the last block (in the block table) or table (in
+	the index) that starts at or before range_off, and seeks the input
+	there; without either, the decoding starts at the first one, at
+	file offset start. Returns the file offset, or -1 on error.
+*/
+static int64_t range_seek( int64_t start, int64_t file_size )
+{
+	lzw_index x;
+	const idx_entry *e;
+	int64_t in_off = 0, in, at;
+	uint32_t lo = 0, hi = fhdr.table_count, mid;
+	
+	if ( block_mode && (fhdr.flags & HDR_TABLE) ) {
+		/* the blocks are in input order. */
+		while ( lo < hi ) {
+			mid = lo + (hi - lo) / 2;
+			if ( !read_table_entry( mid, &in, &at ) ) goto bad_table;
+			if ( in <= range_off ) lo = mid + 1;
+			else hi = mid;
+		}
+		if ( lo && !read_table_entry( lo-1, &in_off, &start ) ) goto bad_table;
+	}
+	else if ( block_mode ) fprintf(stderr, "\nNo block table: decoding from the start.");
+	else if ( idx_read( index_name, &x ) ) {
+		if ( x.file_size != (uint64_t) file_size || ((fhdr.flags & HDR_SIZE) && x.data_size != fhdr.size) ) {
+			fprintf(stderr, "\nError: %s is not the index of this file.", index_name );
+			idx_free( &x );
+			return -1;
+		}
+		if ( (e = idx_find( &x, range_off )) != NULL ) {
+			in_off = e->out_off;
+			start = e->bit_off / 8;
+			dec_skip_bits = e->bit_off % 8;
+			dec_state = e->state;
+		}
+		idx_free( &x );
+	}
+	else fprintf(stderr, "\nNo index %s (make one with -d --index): decoding from the start.", index_name );
+	
+	range_from = range_off - in_off;
+	range_to = range_from + range_len;
+	if ( fseeko( gIN, start, SEEK_SET ) != 0 ) {
+		fprintf(stderr, "\nError: cannot seek the input.");
+		return -1;
+	}
+	return start;
+	
+	bad_table:
+	fprintf(stderr, "\nError: cannot read the block table.");
+	return -1;
+}
+
+/*
+	Sets the decoder from the header of a member (fhdr); prints an
+	error and returns 0 if it is not that of an lzwhc file.
+*/
+static int member_mode( const char *name )
+{
+	if ( !hdr_check( &fhdr, HDR_LZWHC ) ) {
+		dec_error( nbytes_out );
+		return 0;
+	}
+	if ( fhdr.legacy ) {
+		code_max_bits = fhdr.legacy_int[ 0 ] & 0xff;
+		clear_mode = (fhdr.legacy_int[ 0 ] & STAMP_CLEAR_MODE) != 0;
+		max_mode = (fhdr.legacy_int[ 0 ] & STAMP_MAX_MODE) != 0;
+		block_mode = (fhdr.legacy_int[ 0 ] & STAMP_BLOCK_MODE) != 0;
+	}
+	else {
+		code_max_bits = fhdr.bits;
+		clear_mode = fhdr.policy == HDR_RESET_CLEAR;
+		max_mode = fhdr.policy == HDR_RESET_SEGMENTS;
+		block_mode = (fhdr.flags & HDR_BLOCKS) != 0;
+		crc_mode = (fhdr.flags & HDR_CRC) != 0;
+	}
+	if ( code_max_bits < 12 || code_max_bits > 28 || (clear_mode && max_mode) || (block_mode && max_mode)
+		|| (fhdr.legacy && (fhdr.legacy_int[ 0 ] & ~(0xff | STAMP_CLEAR_MODE | STAMP_MAX_MODE | STAMP_BLOCK_MODE)))
+		|| (!fhdr.legacy && fhdr.policy > HDR_RESET_SEGMENTS) ) {
+		fprintf(stderr, "\nError: %s is not an lzwhc file.", name );
+		dec_error( nbytes_out );
+		return 0;
+	}
+	code_MAX = 1 << code_max_bits;
+	start_code = clear_mode || max_mode ? CLEAR_LZW_CODE + 1 : START_LZW_CODE;
+	nspecial = clear_mode || max_mode ? 2 : 1;
+	crc_writes = crc_mode && !range_mode;
+	return 1;
+}
+
+/* allocates the phrase table for code_MAX codes (again, if a member needs more). */
+static int alloc_phrase_table( void )
+{
+	static int size = 0;
+	
+	if ( code_MAX <= size ) return 1;
+	if ( phrase_tail ) free( phrase_tail );
+	if ( phrase_len ) free( phrase_len );
+	if ( phrase_back ) free( phrase_back );
+	phrase_tail = (uint64_t *) malloc( sizeof(uint64_t) * code_MAX );
+	phrase_len = (int *) malloc( sizeof(int) * code_MAX );
+	phrase_back = (int *) malloc( sizeof(int) * code_MAX );
+	if ( !phrase_tail || !phrase_len || !phrase_back ) {
+		fprintf(stderr, "\n Error alloc: phrase table.");
+		dec_error( nbytes_out );
+		return 0;
+	}
+	size = code_MAX;
+	return 1;
+}
+
+/*
+	The file offset where the member just decoded ends: after its last
+	code (or BLOCK_END), its checksum, if not read, and its block table.
+	The whole bytes left in the bit reservoir are not part of the codes.
+*/
+static int64_t member_end( void )
+{
+	int64_t end = nbytes_read + (gbuf - gbuf_start);
+	
+	if ( !block_mode ) end -= dec_bitcnt / 8;
+	if ( crc_mode && !crc_writes ) end += 4;
+	if ( fhdr.flags & HDR_TABLE ) end += (int64_t) fhdr.table_count * HDR_TABLE_ENTRY;
+	return end;
+}
+
+/* fills the input buffer from file offset off, where gIN is (the next member). */
+static int refill_at( int64_t off )
+{
+	/* (the bytes skipped count as read, those read again do not.) */
+	progress_in( off - (nbytes_read + nfread) );
+	nbytes_read = off;
+	nfread = 0;
+	return refill_gbuf();
+}
+
+/*
+	Reserves the disk blocks of the whole output when the header gives
+	its size, without changing the file size (so a decoder that stops
+	early leaves no zeros behind). Not in the block mode, whose output
+	may be sparse.
+*/
+static void preallocate_output( void )
+{
+#if defined( __linux__ ) && defined( FALLOC_FL_KEEP_SIZE )
+	struct stat st;
+	
+	if ( block_mode || !(fhdr.flags & HDR_SIZE) || fhdr.size < PREALLOC_MIN ) return;
+	if ( fstat( fileno( pOUT ), &st ) == 0 && S_ISREG( st.st_mode ) ) {
+		fallocate( fileno( pOUT ), FALLOC_FL_KEEP_SIZE, 0, (off_t) fhdr.size );
+	}
+#endif
+}
+
+/*
+	Copies n bytes from the input file to the output file in the
+	kernel (copy_file_range()), when both are regular files on Linux;
+	the input buffer must be empty and the output buffer flushed.
+	Returns the number of bytes copied, 0 if it cannot be done.
+*/
+static int64_t copy_range( int64_t n )
+{
+	int64_t done = 0;
+#if defined( __linux__ )
+	struct stat sin, sout;
+	off_t in_off, out_off;
+	ssize_t k;
+	int prev;
+	
+	if ( n < COPY_RANGE_MIN || fstat( fileno( gIN ), &sin ) != 0 || fstat( fileno( pOUT ), &sout ) != 0
+		|| !S_ISREG( sin.st_mode ) || !S_ISREG( sout.st_mode ) ) return 0;
+	fflush( pOUT );
+	in_off = ftello( gIN );
+	out_off = ftello( pOUT );
+	prev = phase_switch( PHASE_WRITE );
+	while ( done < n ) {
+		k = copy_file_range( fileno( gIN ), &in_off, fileno( pOUT ), &out_off, n - done, 0 );
+		if ( k <= 0 ) break;
+		done += k;
+	}
+	fseeko( gIN, in_off, SEEK_SET );
+	fseeko( pOUT, out_off, SEEK_SET );
+	phase_switch( prev );
+	nbytes_read += done;
+	nbytes_out += done;
+	progress_in( done );
+	progress_out( done );
+#endif
+	return done;
+}
+
+/* the output is a regular file: 1, no: 0, not known yet: -1. */
+static int sparse_out = -1;
+
+/* holes were made in the output, which may end with one. */
+static int out_holes = 0;
+
+/*
+	Writes n bytes c to the output (a RUN block); zeros in a regular
+	file are left as a hole, and -v writes nothing.
+*/
+static void write_run( int c, int64_t n )
+{
+	static unsigned char run[ 65536 ];
+	struct stat st;
+	int64_t k;
+	int prev;
+	
+	flush_put_buffer();
+	if ( sparse_out < 0 ) sparse_out = !range_mode && fstat( fileno( pOUT ), &st ) == 0 && S_ISREG( st.st_mode );
+	if ( verify_only || (c == 0 && sparse_out && fseeko( pOUT, n, SEEK_CUR ) == 0) ) {
+		if ( crc_writes ) io_crc = crc32c_combine( io_crc, crc32c_run( c, n ), n );
+		nbytes_out += n;
+		progress_out( n );
+		if ( !verify_only ) out_holes = 1;
+		return;
+	}
+	memset( run, c, sizeof(run) );
+	prev = phase_switch( PHASE_WRITE );
+	while ( n > 0 ) {
+		k = n < (int64_t) sizeof(run) ? n : (int64_t) sizeof(run);
+		gt_fwrite( run, k, pOUT );
+		nbytes_out += k;
+		n -= k;
+	}
+	phase_switch( prev );
+}
+
+/*
+	Copies the n bytes at offset off of the output to its end (a REF
+	block), reading them back from the output file.
+*/
+static int copy_ref( int64_t off, int64_t n )
+{
+	static unsigned char *buf = NULL;
+	int64_t k;
+	int prev;
+	
+	flush_put_buffer();
+	fflush( pOUT );
+	if ( !buf && (buf = (unsigned char *) malloc( 1<<20 )) == NULL ) return 0;
+	prev = phase_switch( PHASE_WRITE );
+	while ( n > 0 ) {
+		k = n < (1<<20) ? n : (1<<20);
+		if ( pread( fileno( pOUT ), buf, k, off ) != (ssize_t) k ) break;
+		gt_fwrite( buf, k, pOUT );
+		nbytes_out += k;
+		off += k;
+		n -= k;
+	}
+	phase_switch( prev );
+	return n == 0;
+}
+
+/* copies the n bytes of a stored block to the output. */
+static void copy_raw( int64_t n )
+{
+	int64_t k;
+	
+	flush_put_buffer();
+	while ( n > 0 ) {
+		if ( gbuf == gbuf_end ) {
+			/* (the checksum needs the bytes, and a range only some.) */
+			if ( !crc_writes && !range_mode ) n -= copy_range( n );
+			if ( n == 0 || !refill_gbuf() ) break;
+		}
+		k = gbuf_end - gbuf;
+		if ( k > n ) k = n;
+		gt_fwrite( gbuf, k, pOUT );
+		nbytes_out += k;
+		gbuf += k;
+		n -= k;
+	}
+}
+
 void compress_LZW( void )
 {
+	const unsigned char *p;
+	size_t n;
+	
 	/* initialize the LZW code table. */
-	init_code_table();
+	lzw_dict_init( &dict );
+	bit_count = dict.bit_count;
 	
-	/* start of codes to define. */
-	lzw_code_cnt = START_LZW_CODE;
+	/* match the whole input buffer, then fill it again. */
+	while ( nfread ) {
+		TRACE_BEGIN( "buffer" );
+		p = gbuf;
+		while ( p < gbuf_end ) {
+			phase_switch( PHASE_MATCH );
+			n = lzw_match( &dict, &p, gbuf_end, codes, NCODES );
+			phase_switch( PHASE_PACK );
+			pack_codes( codes, n );
+		}
+#if defined( LZW_STATS )
+		if ( stats_requested ) {
+			stats_requested = 0;
+			lzw_stats_report( &dict, stderr );
+		}
+#endif
+		gbuf = gbuf_end;
+		TRACE_END( "buffer" );
+		refill_gbuf();
+	}
 	
-	/* get first character. */
-	if ( (c=gfgetc()) != EOF ) {
-		prefix_string_code = c;	/* first prefix code. */
+	/* output last code and the END-of-FILE code. */
+	n = lzw_match_end( &dict, codes );
+	pack_codes( codes, n );
+	phase_switch( PHASE_OTHER );
+	enc_segments = dict.resets + 1;
+	LZW_STAT( lzw_stats_report( &dict, stderr ); )
+}
+
+/*
+	The max mode: reads the whole input, finds its segments and their
+	tables (LZWMAX.C), then compresses each segment after a header with
+	its code size and policy; a CLEAR code ends each segment but the last.
+*/
+void compress_max( int64_t size )
+{
+	static lzw_dict seg_dict[ MAX_SEARCH_BITS+1 ];
+	unsigned char *buf;
+	const unsigned char *p;
+	max_segment *segs, empty = { 0, 0, 12, 0 };
+	int64_t got;
+	int i, nseg;
+	lzw_dict *d;
+	size_t n;
+	
+	if ( (buf = (unsigned char *) malloc( size ? size : 1 )) == NULL )
+		enc_fail( "input buffer" );
+	got = get_bytes( buf, size );
+	
+	phase_switch( PHASE_SEARCH );
+	TRACE_BEGIN( "search" );
+	/* (an empty input is one empty segment, for the decoder.) */
+	if ( got == 0 ) {
+		segs = &empty;
+		nseg = 1;
 	}
+	else nseg = max_search( buf, got, code_max_bits, nthreads, &segs );
+	TRACE_END( "search" );
+	if ( nseg == 0 ) enc_fail( "segment search" );
 	
-	while( (c=gfgetc()) != EOF ) {
-		if ( !search_string(prefix_string_code, c) ) {
-			output_code ( (unsigned int) prefix_string_code, bit_count );
-			
-			/* ---- insert the string in the string table. ---- */
-			if ( lzw_code_cnt < code_MAX ){
-				insert_stringENC( prefix_string_code, c );
-				if ( lzw_code_cnt == code_max ) {
-					bit_count++;
-					code_max <<= 1;
+	for ( i = 0; i < nseg; i++ ) {
+		d = &seg_dict[ segs[i].bits ];
+		if ( !d->code && !lzw_dict_alloc( d, segs[i].bits ) ) enc_fail( "code tables" );
+		TRACE_BEGIN( "segment" );
+		phase_switch( PHASE_PACK );
+		output_code( segs[i].bits | (segs[i].blind ? MAX_HEADER_BLIND : 0), MAX_HEADER_BITS );
+		lzw_dict_use_segments( d, segs[i].blind );
+		lzw_dict_init( d );
+		bit_count = d->bit_count;
+		d->resets = 0;
+		p = buf + segs[i].start;
+		while ( p < buf + segs[i].end ) {
+			phase_switch( PHASE_MATCH );
+			n = lzw_match( d, &p, buf + segs[i].end, codes, NCODES );
+			phase_switch( PHASE_PACK );
+			pack_codes( codes, n );
+		}
+		n = i+1 < nseg ? lzw_match_clear( d, codes ) : lzw_match_end( d, codes );
+		pack_codes( codes, n );
+		enc_segments += d->resets + 1;
+		TRACE_END( "segment" );
+	}
+	phase_switch( PHASE_OTHER );
+	
+	for ( i = 0; i <= MAX_SEARCH_BITS; i++ ) lzw_dict_free( &seg_dict[ i ] );
+	if ( segs != &empty ) free( segs );
+	free( buf );
+}
+
+/*
+	Writes a block header, with the checksum crc of the block's len
+	input bytes; the output must be at a byte boundary.
+*/
+static void put_block_header( int type, int64_t len, int64_t stored, uint32_t crc )
+{
+	if ( blk_table_n == blk_table_cap ) {
+		blk_table_cap = blk_table_cap ? 2*blk_table_cap : 1024;
+		if ( (blk_table = (int64_t *) realloc( blk_table, sizeof(int64_t) * 2 * blk_table_cap )) == NULL )
+			enc_fail( "block table" );
+	}
+	blk_table[ 2*blk_table_n ] = blk_in_off;
+	blk_table[ 2*blk_table_n+1 ] = nbytes_out + pbuf_count;
+	blk_table_n++;
+	blk_in_off += len;
+	output_code( type, 8 );
+	output_code( (unsigned) len, 32 );
+	output_code( (unsigned) stored, 32 );
+	if ( crc_mode ) {
+		output_code( crc, 32 );
+		data_crc = crc32c_combine( data_crc, crc, len );
+	}
+}
+
+/* the checksum of p[0..n-1] for its block header, if any. */
+static uint32_t block_crc( const unsigned char *p, int64_t n )
+{
+	int prev;
+	uint32_t crc;
+	
+	if ( !crc_mode ) return 0;
+	prev = phase_switch( PHASE_CHECK );
+	crc = crc32c( 0, p, n );
+	phase_switch( prev );
+	return crc;
+}
+
+/* the run waiting for its RUN block: it may go on in the next block. */
+static int64_t run_len = 0;
+static int run_byte = 0;
+
+/*
+	The blocks, runs and references wait in a queue as items, in the
+	order of the input, while the pool codes the blocks; they are
+	written in that order as the pool hands them back.
+*/
+typedef struct {
+	int type;                   /* BLOCK_LZW (a block of data), BLOCK_RUN or BLOCK_REF. */
+	const unsigned char *p;     /* the data of a block, in an input buffer. */
+	int64_t len, off;           /* input bytes; the offset of a reference. */
+	int c;                      /* the byte of a run. */
+	uint32_t crc;
+	
+	/* a block, coded: stored raw (2: by the pre-scan), or its codes. */
+	int raw, failed;
+	uint32_t *codes;
+	size_t ncodes, cap;
+	int64_t bits, segments;
+} blk_item;
+
+static blk_item *blk_items = NULL;
+static int blk_queue = 0;
+static int64_t blk_queued = 0, blk_written = 0;
+
+/* the tables of the workers (the main thread, worker 0, codes with dict). */
+static lzw_dict *blk_dicts = NULL;
+
+/*
+	Codes a block, on a worker of the pool or on the main thread:
+	stored raw if the entropy pre-scan finds it random; otherwise
+	matched into one code array, and stored raw anyway if its codes
+	take as many bytes as it does. Only the main thread times phases.
+*/
+static void code_block( void *job, int worker )
+{
+	blk_item *b = (blk_item *) job;
+	lzw_dict *d = worker ? &blk_dicts[ worker-1 ] : &dict;
+	const unsigned char *p = b->p, *end = b->p + b->len;
+	uint32_t *t;
+	size_t cap;
+	int w, resets;
+	
+	if ( b->type != BLOCK_LZW ) return;
+	max_worker = worker != 0;
+	TRACE_BEGIN( "block" );
+	if ( worker ) b->crc = crc_mode ? crc32c( 0, p, b->len ) : 0;
+	else b->crc = block_crc( p, b->len );
+	b->raw = 0;
+	if ( entropy_scan ) {
+		if ( !worker ) phase_switch( PHASE_SCAN );
+		if ( scan_entropy( p, b->len ) >= SCAN_ENTROPY_RAW ) b->raw = 2;
+	}
+	if ( !b->raw ) {
+		lzw_dict_init( d );
+		resets = d->resets;
+		b->ncodes = 0;
+		if ( !worker ) phase_switch( PHASE_MATCH );
+		while ( 1 ) {
+			if ( b->cap - b->ncodes < NCODES ) {
+				cap = b->cap ? 2*b->cap : (size_t) b->len / 2 + 2*NCODES;
+				if ( (t = (uint32_t *) realloc( b->codes, sizeof(uint32_t) * cap )) == NULL ) {
+					b->failed = 1;
+					break;
 				}
+				b->codes = t;
+				b->cap = cap;
 			}
-			
-			/*  Instead of monitoring comp. ratio, we simply reset 
-				the string table after N output codes. 
-				No CLEAR_TABLE code is transmitted. */
-			if ( lzw_code_cnt++ == (code_MAX+4096) ) {
-				init_code_table();
-				lzw_code_cnt = START_LZW_CODE;
-				bit_count =   9;
-				code_max  = 512;
+			if ( p == end ) break;
+			b->ncodes += lzw_match( d, &p, end, b->codes + b->ncodes, b->cap - b->ncodes );
+		}
+		if ( !b->failed ) {
+			b->ncodes += lzw_match_end( d, b->codes + b->ncodes );
+			w = 9;
+			b->bits = lzw_count_bits( b->codes, b->ncodes, &w );
+			b->raw = (b->bits + 7) / 8 >= b->len;
+			b->segments = d->resets - resets + 1;
+		}
+	}
+	TRACE_END( "block" );
+}
+
+/* writes the oldest item of the queue; waiting for the pool counts as matching. */
+static void write_oldest( void )
+{
+	blk_item *b;
+	
+	phase_switch( PHASE_MATCH );
+	b = (blk_item *) pool_wait();
+	if ( b->failed ) {
+		/* a worker ran out of memory: the main thread tries again. */
+		b->failed = 0;
+		code_block( b, 0 );
+	}
+	phase_switch( PHASE_PACK );
+	if ( b->type == BLOCK_RUN ) {
+		put_block_header( BLOCK_RUN, b->len, 1, b->crc );
+		output_code( b->c, 8 );
+		run_blocks++;
+		run_bytes += b->len;
+	}
+	else if ( b->type == BLOCK_REF ) {
+		put_block_header( BLOCK_REF, b->len, 8, b->crc );
+		output_code( (unsigned) b->off, 32 );
+		output_code( (unsigned) (b->off >> 32), 32 );
+		ref_blocks++;
+		ref_bytes += b->len;
+	}
+	else if ( b->failed ) enc_fail( "block codes" );
+	else if ( b->raw ) {
+		put_block_header( BLOCK_RAW, b->len, b->len, b->crc );
+		flush_put_buffer();
+		gt_fwrite( b->p, b->len, pOUT );
+		nbytes_out += b->len;
+		raw_blocks++;
+		stored_bytes += b->len;
+		if ( b->raw == 2 ) bypassed_bytes += b->len;
+	}
+	else {
+		put_block_header( BLOCK_LZW, b->len, (b->bits + 7) / 8, b->crc );
+		bit_count = 9;
+		pack_codes( b->codes, b->ncodes );
+		if ( p_cnt ) output_code( 0, 8 - p_cnt );
+		enc_segments += b->segments;
+		lzw_blocks++;
+	}
+	/* (the code arrays of the items in flight are all the memory they take.) */
+	if ( b->codes ) free( b->codes );
+	b->codes = NULL;
+	b->cap = 0;
+	blk_written++;
+}
+
+/* writes the items of the queue up to item n (all of them: blk_queued). */
+static void write_items( int64_t n )
+{
+	while ( blk_written < n ) write_oldest();
+}
+
+/* the next item of the queue, after writing the oldest one if it is full. */
+static blk_item *new_item( int type )
+{
+	blk_item *b;
+	
+	if ( blk_queued - blk_written >= blk_queue ) write_oldest();
+	b = &blk_items[ blk_queued++ % blk_queue ];
+	b->type = type;
+	b->failed = 0;
+	return b;
+}
+
+/* queues the waiting run as a RUN block. */
+static void flush_run( void )
+{
+	blk_item *b;
+	
+	if ( run_len == 0 ) return;
+	b = new_item( BLOCK_RUN );
+	b->len = run_len;
+	b->c = run_byte;
+	b->crc = crc_mode ? crc32c_run( run_byte, run_len ) : 0;
+	pool_submit( b );
+	run_len = 0;
+}
+
+/* the reference waiting for its REF block: ref_len bytes at ref_off, and their checksum. */
+static int64_t ref_off = 0, ref_len = 0;
+static uint32_t ref_crc = 0;
+
+/* queues the waiting reference as a REF block. */
+static void flush_ref( void )
+{
+	blk_item *b;
+	
+	if ( ref_len == 0 ) return;
+	b = new_item( BLOCK_REF );
+	b->len = ref_len;
+	b->off = ref_off;
+	b->crc = ref_crc;
+	pool_submit( b );
+	ref_len = 0;
+}
+
+/* adds the n bytes of p, at input offset off, to the waiting reference. */
+static void put_ref( int64_t off, const unsigned char *p, int64_t n )
+{
+	flush_run();
+	if ( ref_len && (off != ref_off + ref_len || ref_len + n > BLOCK_RUN_MAX) ) flush_ref();
+	if ( ref_len == 0 ) {
+		ref_off = off;
+		ref_crc = 0;
+	}
+	if ( crc_mode ) ref_crc = crc32c_combine( ref_crc, block_crc( p, n ), n );
+	ref_len += n;
+}
+
+/* adds n bytes c to the waiting run. */
+static void put_run( int c, int64_t n )
+{
+	flush_ref();
+	if ( run_len && c != run_byte ) flush_run();
+	run_byte = c;
+	while ( run_len + n > BLOCK_RUN_MAX ) {
+		n -= BLOCK_RUN_MAX - run_len;
+		run_len = BLOCK_RUN_MAX;
+		flush_run();
+	}
+	run_len += n;
+}
+
+/* the input is a regular file with SEEK_DATA/SEEK_HOLE: 1, no: 0, not known yet: -1. */
+static int sparse_in = -1;
+
+/*
+	Sparse input: if the input is at a hole, adds the hole to the
+	waiting run of zeros, and reads past it only what the input
+	buffer already holds. Returns max, or less so that the next
+	block ends where the next hole starts.
+*/
+static int64_t skip_hole( int64_t max )
+{
+#if defined( SEEK_HOLE ) && defined( SEEK_DATA )
+	static off_t size;
+	struct stat st;
+	off_t fdpos, pos, end, data, hole = -1;
+	int fd = fileno( gIN );
+	
+	if ( sparse_in < 0 ) {
+		sparse_in = fstat( fd, &st ) == 0 && S_ISREG( st.st_mode );
+		size = st.st_size;
+	}
+	if ( !sparse_in ) return max;
+	
+	/* the input bytes up to end are in the buffers already. */
+	end = ftello( gIN );
+	pos = end - (gbuf_end - gbuf);
+	fdpos = lseek( fd, 0, SEEK_CUR );
+	if ( (data = lseek( fd, pos, SEEK_DATA )) < 0 ) data = errno == ENXIO ? size : -1;
+	if ( data >= 0 && (hole = lseek( fd, data, SEEK_HOLE )) < 0 ) hole = errno == ENXIO ? size : -1;
+	lseek( fd, fdpos, SEEK_SET );
+	if ( data < 0 || hole < 0 ) {
+		sparse_in = 0;  /* no SEEK_DATA support in the file system. */
+		return max;
+	}
+	
+	if ( data > pos ) {
+		put_run( 0, data - pos );
+		if ( data <= end ) gbuf += data - pos;
+		else {
+			nbytes_read += nfread + (data - end);
+			progress_in( data - end );
+			nfread = 0;
+			gbuf = gbuf_end = gbuf_start;
+			fseeko( gIN, data, SEEK_SET );
+		}
+	}
+	if ( hole > data && hole - data < max ) max = hole - data;
+#endif
+	return max;
+}
+
+/* queues blk[0..len-1], in an input buffer, as one block for the pool. */
+static void put_block( const unsigned char *blk, int64_t len )
+{
+	blk_item *b;
+	
+	flush_run();
+	flush_ref();
+	b = new_item( BLOCK_LZW );
+	b->p = blk;
+	b->len = len;
+	pool_submit( b );
+}
+
+/* the input has the n bytes of p at offset off (checks a duplicate chunk). */
+static int same_input( int64_t off, const unsigned char *p, size_t n )
+{
+	static unsigned char buf[ DEDUP_MAX_CHUNK ];
+	
+	return pread( fileno( gIN ), buf, n, off ) == (ssize_t) n && memcmp( buf, p, n ) == 0;
+}
+
+/*
+	The deduplication: cuts p[0..len-1], at input offset off, into
+	chunks. A chunk that is in the chunk table, and whose bytes are
+	the same in the input there, becomes a reference; the bytes between
+	the references go to put_block().
+*/
+static void put_data( const unsigned char *p, int64_t len, int64_t off )
+{
+	static size_t *cuts = NULL;
+	static uint64_t *fps = NULL;
+	dedup_chunk *e;
+	int64_t i, u, s, n;
+	int k, nc;
+	
+	if ( !dedup ) {
+		put_block( p, len );
+		return;
+	}
+	if ( !cuts ) {
+		n = block_size / DEDUP_MIN_CHUNK + 1;
+		cuts = (size_t *) malloc( sizeof(size_t) * n );
+		fps = (uint64_t *) malloc( sizeof(uint64_t) * n );
+		if ( !cuts || !fps ) enc_fail( "dedup chunks" );
+	}
+	phase_switch( PHASE_DEDUP );
+	TRACE_BEGIN( "dedup" );
+	for ( nc = 0, i = 0; i < len; nc++ ) {
+		i += dedup_cut( p + i, len - i );
+		cuts[ nc ] = i;
+	}
+	dedup_fingerprints( p, cuts, nc, fps );
+	TRACE_END( "dedup" );
+	
+	/* the bytes from u on are not written yet. */
+	for ( u = 0, s = 0, k = 0; k < nc; s = cuts[ k++ ] ) {
+		n = cuts[ k ] - s;
+		if ( n < DEDUP_MIN_REF ) continue;
+		phase_switch( PHASE_DEDUP );
+		if ( (e = dedup_find( fps[ k ], n )) == NULL ) {
+			dedup_insert( fps[ k ], off + s, n );
+			continue;
+		}
+		if ( !same_input( e->off, p + s, n ) ) continue;
+		if ( s > u ) put_block( p + u, s - u );
+		put_ref( e->off, p + s, n );
+		u = cuts[ k ];
+	}
+	if ( len > u ) put_block( p + u, len - u );
+}
+
+/* writes the checksum of the data after the last code, at a byte boundary. */
+static void put_data_crc( void )
+{
+	if ( p_cnt ) output_code( 0, 8 - p_cnt );
+	output_code( block_mode ? data_crc : io_crc, 32 );
+}
+
+/*
+	Writes the block table after BLOCK_END (and the checksum), if the
+	output is a regular file: its header, written again at the end,
+	then points to it.
+*/
+static void put_block_table( void )
+{
+	struct stat st;
+	size_t i;
+	
+	if ( fstat( fileno( pOUT ), &st ) != 0 || !S_ISREG( st.st_mode ) ) return;
+	fhdr.table_off = nbytes_out + pbuf_count;
+	fhdr.table_count = (uint32_t) blk_table_n;
+	fhdr.flags |= HDR_TABLE;
+	for ( i = 0; i < 2*blk_table_n; i++ ) {
+		output_code( (unsigned) blk_table[ i ], 32 );
+		output_code( (unsigned) (blk_table[ i ] >> 32), 32 );
+	}
+	free( blk_table );
+	blk_table = NULL;
+}
+
+/*
+	The block mode: the runs of one byte of at least BLOCK_RUN_MIN
+	bytes, and the holes of a sparse input, go to RUN blocks, and the
+	bytes between them to put_data(). A block ends where a hole starts.
+	The input is read into nbuf buffers in turn, and a buffer is read
+	into again once the blocks of its data are written.
+*/
+void compress_blocks( void )
+{
+	unsigned char *buf, *blk;
+	int64_t *buf_last;   /* the queue up to the last item of each buffer. */
+	int64_t len, max, off, i, at, table_bytes;
+	struct stat st;
+	int workers, ndicts, nbuf, k;
+	size_t n;
+	
+	if ( dedup && (fstat( fileno( gIN ), &st ) != 0 || !S_ISREG( st.st_mode )) ) {
+		fprintf(stderr, "\nThe input is not a regular file: no --dedup.");
+		dedup = 0;
+	}
+	
+	/* the workers (the main thread is one more), and the buffers to keep them busy. */
+	workers = (nthreads > 0 ? nthreads : (int) sysconf( _SC_NPROCESSORS_ONLN )) - 1;
+	table_bytes = (int64_t) dict.hash_TABLE_SIZE * (2 * sizeof(int) + 1);
+	while ( workers > 0 && workers * table_bytes > BLOCK_POOL_MEM / 2 ) workers--;
+	nbuf = workers > 0 ? 2 * (workers + 1) : 1;
+	while ( nbuf > 1 && nbuf * block_size > BLOCK_POOL_MEM / 2 ) nbuf--;
+	blk_queue = BLOCK_QUEUE * nbuf;
+	buf = (unsigned char *) malloc( nbuf * block_size );
+	buf_last = (int64_t *) calloc( nbuf, sizeof(int64_t) );
+	blk_items = (blk_item *) calloc( blk_queue, sizeof(blk_item) );
+	blk_dicts = (lzw_dict *) calloc( workers + 1, sizeof(lzw_dict) );
+	if ( !buf || !buf_last || !blk_items || !blk_dicts ) enc_fail( "block buffers" );
+	for ( ndicts = 0; ndicts < workers; ndicts++ ) {
+		if ( !lzw_dict_alloc( &blk_dicts[ ndicts ], code_max_bits ) ) break;
+		if ( clear_mode ) lzw_dict_use_clear( &blk_dicts[ ndicts ] );
+	}
+	if ( crc_mode ) crc32c( 0, buf, 0 );  /* (its tables are made before the threads start.) */
+	if ( (workers = pool_start( ndicts, blk_queue, code_block )) < 0 ) enc_fail( "block queue" );
+	blk_threads = workers + 1;
+	
+	for ( k = 0; ; k = (k + 1) % nbuf ) {
+		max = find_runs ? skip_hole( block_size ) : block_size;
+		off = ftello( gIN ) - (gbuf_end - gbuf);  /* (only --dedup needs it.) */
+		blk = buf + k * block_size;
+		write_items( buf_last[ k ] );
+		if ( (len = get_bytes( blk, max )) <= 0 ) break;
+		for ( i = 0; i < len; i = at + n ) {
+			n = 0;
+			at = len;
+			if ( find_runs ) {
+				phase_switch( PHASE_SCAN );
+				at = i + scan_run( blk + i, len - i, BLOCK_RUN_MIN, &n );
 			}
-			
-			/* string = char */
-			prefix_string_code = c;
+			if ( at > i ) put_data( blk + i, at - i, off + i );
+			if ( n ) put_run( blk[ at ], n );
 		}
+		buf_last[ k ] = blk_queued;
+	}
+	flush_run();
+	flush_ref();
+	write_items( blk_queued );
+	pool_stop();
+	output_code( BLOCK_END, 8 );
+	phase_switch( PHASE_OTHER );
+	for ( k = 0; k < ndicts; k++ ) lzw_dict_free( &blk_dicts[ k ] );
+	free( blk_dicts );
+	free( blk_items );
+	free( buf_last );
+	dedup_free();
+	free( buf );
+}
+
+/* loads 8 bytes as a little-endian word. */
+static inline uint64_t load64le( const unsigned char *p )
+{
+	uint64_t w;
+	
+	memcpy( &w, p, 8 );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	w = __builtin_bswap64( w );
+#endif
+	return w;
+}
+
+/*
+	Makes sure the (local) bit reservoir bitbuf/bitcnt holds at least
+	W bits. Past the end of the input, an EOF_LZW_CODE is supplied so
+	that a truncated file simply ends the decoding.
+*/
+#define FILL_BITS( W )   \
+	if ( bitcnt < (W) ) {   \
+		if ( gbuf_end - gbuf >= 8 ) {   \
+			bitbuf |= load64le( gbuf ) << bitcnt;   \
+			gbuf += (63 - bitcnt) >> 3;   \
+			bitcnt |= 56;   \
+		}   \
+		else while ( bitcnt <= 56 ) {   \
+			if ( gbuf == gbuf_end && !refill_gbuf() ) {   \
+				if ( bitcnt < (W) ) {   \
+					bitbuf = EOF_LZW_CODE;   \
+					bitcnt = (W);   \
+				}   \
+				break;   \
+			}   \
+			bitbuf |= (uint64_t) (*gbuf++) << bitcnt;   \
+			bitcnt += 8;   \
+		}   \
 	}
-	/* output last code. */
-	output_code ( (unsigned int) prefix_string_code, bit_count );
+
+/* gets one code of any size from the bit reservoir. */
+static int get_code( int size )
+{
+	uint64_t bitbuf = dec_bitbuf;
+	int bitcnt = dec_bitcnt, c;
 	
-	/* output END-of-FILE code.*/
-	output_code ( (unsigned int) EOF_LZW_CODE, bit_count );
+	FILL_BITS( size );
+	c = (int) (bitbuf & ((1u << size) - 1));
+	dec_bitbuf = bitbuf >> size;
+	dec_bitcnt = bitcnt - size;
+	return c;
 }
 
+/*
+	The body of a decoding loop for W-bit codes: decodes n codes,
+	adding one string per code to the table if INSERT is nonzero.
+	No code size or table reset checks are needed inside the loop;
+	the caller runs exactly as many codes as the code size covers.
+*/
+#define DECODE_LOOP( W, INSERT )   \
+	for ( ; n > 0; n-- ) {   \
+		FILL_BITS( W );   \
+		c = (int) (bitbuf & ((1u << (W)) - 1));   \
+		bitbuf >>= (W);   \
+		bitcnt -= (W);   \
+		if ( c < cnt ) {   \
+			if ( (unsigned) (c - EOF_LZW_CODE) < (unsigned) nspecial ) goto stop;   \
+			/* OUTPUT STRING/PATTERN; K = its first character. */   \
+			K = output_phrase( c );   \
+			/* add PREV_CODE+K to the string table. */   \
+			if ( INSERT ) insert_stringDEC( cnt, old, (unsigned char) K );   \
+		}   \
+		else {   \
+			/* undefined code: it is PREV_CODE+K, so define it first. */   \
+			if ( c > cnt ) goto bad;   \
+			if ( INSERT ) insert_stringDEC( cnt, old, (unsigned char) K );   \
+			output_phrase( c );   \
+		}   \
+		/* PREV_CODE = CURR_CODE */   \
+		old = c;   \
+		cnt++;   \
+	}
+
+/*
+	Defines decode_Wbits( n, insert ), the decoder of n W-bit codes.
+	Returns 0 if EOF_LZW_CODE or CLEAR_LZW_CODE (stop_code) was read,
+	or a code not defined yet (stop_code -1), 1 otherwise.
+*/
+#define DECODE_WIDTH( W )   \
+static int decode_##W##bits( int n, int insert )   \
+{   \
+	uint64_t bitbuf = dec_bitbuf;   \
+	int bitcnt = dec_bitcnt, c, ret = 1;   \
+	int cnt = lzw_code_cnt, old = old_lzw_code, K = first_char;   \
+	\
+	if ( insert ) { DECODE_LOOP( W, 1 ) }   \
+	else { DECODE_LOOP( W, 0 ) }   \
+	goto done;   \
+	\
+	bad: c = -1;   \
+	stop: ret = 0;   \
+	stop_code = c;   \
+	done:   \
+	dec_bitbuf = bitbuf;   \
+	dec_bitcnt = bitcnt;   \
+	lzw_code_cnt = cnt;   \
+	old_lzw_code = old;   \
+	first_char = K;   \
+	return ret;   \
+}
+
+DECODE_WIDTH( 9 )  DECODE_WIDTH( 10 ) DECODE_WIDTH( 11 ) DECODE_WIDTH( 12 )
+DECODE_WIDTH( 13 ) DECODE_WIDTH( 14 ) DECODE_WIDTH( 15 ) DECODE_WIDTH( 16 )
+DECODE_WIDTH( 17 ) DECODE_WIDTH( 18 ) DECODE_WIDTH( 19 ) DECODE_WIDTH( 20 )
+DECODE_WIDTH( 21 ) DECODE_WIDTH( 22 ) DECODE_WIDTH( 23 ) DECODE_WIDTH( 24 )
+DECODE_WIDTH( 25 ) DECODE_WIDTH( 26 ) DECODE_WIDTH( 27 ) DECODE_WIDTH( 28 )
+
+static int (* const decode_nbits[ 29 ])( int, int ) = {
+	NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	decode_9bits,  decode_10bits, decode_11bits, decode_12bits,
+	decode_13bits, decode_14bits, decode_15bits, decode_16bits,
+	decode_17bits, decode_18bits, decode_19bits, decode_20bits,
+	decode_21bits, decode_22bits, decode_23bits, decode_24bits,
+	decode_25bits, decode_26bits, decode_27bits, decode_28bits
+};
+
+/*
+	Each table (reset-to-reset segment) is decoded as a sequence of
+	runs, one per code size: 9-bit codes while the codes 257..511 are
+	defined, then 2^(n-1) n-bit codes for each n up to code_max_bits,
+	and finally 4096 codes with the table full. In the CLEAR mode, the
+	codes start at 258 and the full table is used until a CLEAR code.
+	In the max mode, each segment up to a CLEAR code starts with a
+	header (LZWMAX.H) giving its code size and whether it is decoded
+	as in the CLEAR mode or with resets after CODE_MAX+4K codes.
+*/
 void decompress_LZW( void )
 {
-	/* set the starting code to define. */
-	lzw_code_cnt = START_LZW_CODE;
+	int n, bits = code_max_bits, max = code_MAX;
+	int full = clear_mode, header = max_mode;
 	
-	/* get first code. */
-	old_lzw_code = get_nbits( bit_count );
+	phase_switch( PHASE_DECODE );
+	init_phrase_table();
+	dec_bitbuf = 0;
+	dec_bitcnt = 0;
 	
-	/* first code is a character; output it. */
-	pfputc( (unsigned char) old_lzw_code );
+	/* a range that starts at an entry of the index. */
+	if ( dec_skip_bits ) get_code( dec_skip_bits );
+	if ( dec_state ) {
+		bits = dec_state & MAX_HEADER_SIZE;
+		if ( bits < 12 || bits > code_max_bits ) {
+			fprintf(stderr, "\nError: bad index entry.");
+			dec_error( 0 );
+			return;
+		}
+		max = 1 << bits;
+		full = !(dec_state & MAX_HEADER_BLIND);
+		header = 0;
+	}
+	dec_skip_bits = dec_state = 0;
 	
 	while ( 1 ) {
-		new_lzw_code = get_nbits( bit_count );
+		if ( range_done() ) return;
+		if ( make_index && !dec_in_block && !idx_add( &seg_index,
+				8 * (nbytes_read + (gbuf - gbuf_start)) - dec_bitcnt, nbytes_out + pbuf_count,
+				max_mode && !header ? bits | (full ? 0 : MAX_HEADER_BLIND) : 0 ) ) {
+			fprintf(stderr, "\n Error alloc: seek index.");
+			dec_error( nbytes_out + pbuf_count );
+			return;
+		}
+		if ( header ) {
+			n = get_code( MAX_HEADER_BITS );
+			bits = n & MAX_HEADER_SIZE;
+			if ( bits < 12 || bits > code_max_bits ) {
+				fprintf(stderr, "\nError: bad segment header.");
+				dec_error( nbytes_out + pbuf_count );
+				return;
+			}
+			max = 1 << bits;
+			full = !(n & MAX_HEADER_BLIND);
+			header = 0;
+		}
 		
-		if ( new_lzw_code == EOF_LZW_CODE ) break;
-		else if ( new_lzw_code >= lzw_code_cnt ) lzwcode = old_lzw_code;
-		else lzwcode = new_lzw_code;
+		/* set the starting code to define. */
+		lzw_code_cnt = start_code;
 		
-		/* GET STRING/PATTERN. */
-		stack = stack_buffer;
-		while ( lzwcode > EOF_LZW_CODE ) {
-			*stack++ = character[ lzwcode ];
-			/* when loop exits, lzwcode must be a character. */
-			lzwcode = prefix[ lzwcode ];
+		/* get first code. */
+		old_lzw_code = get_code( 9 );
+		if ( old_lzw_code == EOF_LZW_CODE ) break;
+		if ( old_lzw_code == CLEAR_LZW_CODE && nspecial > 1 ) {
+			header = max_mode;
+			continue;
 		}
+		if ( old_lzw_code > 255 ) goto bad;  /* (the first code of a table is a byte.) */
+		dec_segments++;
+		TRACE_BEGIN( "segment" );
 		
-		/* K = get first character of string. */
-		*stack = lzwcode;
+		/* first code is a character; output it. */
+		pfputc( first_char = (unsigned char) old_lzw_code );
 		
-		/* OUTPUT STRING/PATTERN. */
-		while ( stack >= stack_buffer ) {
-			pfputc( *stack-- );
-		}
-		/* if undefined code. */
-		if ( new_lzw_code >= lzw_code_cnt ) {
-			pfputc( lzwcode );
-		}
-
-		/* add PREV_CODE+K to the string table. */
-		if ( lzw_code_cnt < code_MAX ) {
-			insert_stringDEC( old_lzw_code, (unsigned char) lzwcode );
-			if ( bit_count < code_max_bits ){
-				if ( lzw_code_cnt == (code_max-1) ) {
-					bit_count++;
-					code_max <<= 1;
-				}
-			}
+		if ( !decode_nbits[ 9 ]( 511 - start_code + 1, 1 ) ) goto stop;
+		for ( n = 10; n < bits; n++ ) {
+			if ( !decode_nbits[ n ]( 1 << (n-1), 1 ) ) goto stop;
 		}
+		if ( !decode_nbits[ bits ]( max - (max >> 1), 1 ) ) goto stop;
 		
-		/* PREV_CODE = CURR_CODE */
-		old_lzw_code = new_lzw_code;
-		
+		if ( full ) {
+			/* the table is full until a CLEAR code; no code is defined. */
+			ncodes += lzw_code_cnt - start_code + 1;
+			do {
+				lzw_code_cnt = max;
+				n = decode_nbits[ bits ]( 1<<16, 0 );
+				ncodes += lzw_code_cnt - max;
+			} while ( n && !range_done() );
+			goto cleared;
+		}
 		/* reset table if number of codes transmitted reach (code_MAX+4K) */
-		if ( ++lzw_code_cnt == (code_MAX+4096) ) {
-			lzw_code_cnt = START_LZW_CODE;
-			bit_count =   9;
-			code_max  = 512;
-			
-			/* get first code. */
-			old_lzw_code = get_nbits( bit_count );
-			
-			/* first code is a character; output it. */
-			pfputc( (unsigned char) old_lzw_code );
+		else if ( decode_nbits[ bits ]( 4096, 0 ) ) {
+			ncodes += lzw_code_cnt - start_code + 1;
+			TRACE_END( "segment" );
+			continue;
+		}
+		
+		stop:
+		ncodes += lzw_code_cnt - start_code + 1;
+		cleared:
+		TRACE_END( "segment" );
+		if ( stop_code == EOF_LZW_CODE ) return;
+		if ( stop_code < 0 ) goto bad;
+		header = max_mode;
+	}
+	ncodes++;  /* the END-of-FILE code. */
+	return;
+	
+	bad:
+	fprintf(stderr, "\nError: bad code at output byte %lld.", (long long) (nbytes_out + pbuf_count) );
+	dec_error( nbytes_out + pbuf_count );
+}
+
+/* a 32-bit little-endian number. */
+static int64_t get_le32( const unsigned char *p )
+{
+	return (int64_t) ((uint32_t) p[0] | (uint32_t) p[1] << 8
+		| (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+}
+
+/*
+	The block mode: a stored block is copied, a RUN block written out
+	from its byte, a REF block copied from the output; an LZW block is read
+	whole into memory and decoded from there by decompress_LZW(),
+	which sees the end of the block as the end of the input.
+	
+	The sizes of a block header are checked before anything is sized
+	from them: a RAW or LZW block is at most BLOCK_MAX_SIZE bytes of
+	input, an LZW block is shorter than its input (or the encoder would
+	have stored it raw), and no block is longer than the input left.
+*/
+void decompress_blocks( void )
+{
+	unsigned char h[ BLOCK_HEADER_SIZE+BLOCK_CRC_SIZE ], *blk = NULL, *t, *save_gbuf, *save_end;
+	int64_t len, stored, cap = 0, out, ref, in_size = -1;
+	int hsize = BLOCK_HEADER_SIZE + (crc_mode ? BLOCK_CRC_SIZE : 0);
+	uint32_t crc = 0;
+	struct stat st;
+	
+	/* (the size of a pipe is not known: the blocks are then checked as read.) */
+	if ( fstat( fileno( gIN ), &st ) == 0 && S_ISREG( st.st_mode ) ) in_size = st.st_size;
+	while ( !range_done() && get_bytes( h, 1 ) == 1 && h[0] != BLOCK_END ) {
+		if ( h[0] > BLOCK_REF || get_bytes( h+1, hsize-1 ) != hsize-1
+			|| (h[0] == BLOCK_RUN && get_le32( h+5 ) != 1)
+			|| (h[0] == BLOCK_REF && get_le32( h+5 ) != 8) ) {
+			fprintf(stderr, "\nError: bad block header.");
+			dec_error( nbytes_out + pbuf_count );
+			break;
+		}
+		len = get_le32( h+1 );
+		stored = get_le32( h+5 );
+		if ( ((h[0] == BLOCK_RAW || h[0] == BLOCK_LZW) && len > BLOCK_MAX_SIZE)
+			|| (h[0] == BLOCK_RAW && stored != len)
+			|| (h[0] == BLOCK_LZW && stored >= len)
+			|| (in_size >= 0 && stored > in_size - (ftello( gIN ) - (gbuf_end - gbuf))) ) {
+			fprintf(stderr, "\nError: bad block header (input size %lld, stored size %lld).",
+				(long long) len, (long long) stored );
+			dec_error( nbytes_out + pbuf_count );
+			break;
 		}
+		if ( crc_mode ) crc = (uint32_t) get_le32( h+9 );
+		out = nbytes_out + pbuf_count;
+		io_crc = 0;
+		TRACE_BEGIN( "block" );
+		if ( h[0] == BLOCK_RAW ) {
+			copy_raw( stored );
+			raw_blocks++;
+		}
+		else if ( h[0] == BLOCK_RUN ) {
+			if ( get_bytes( h, 1 ) != 1 ) {
+				fprintf(stderr, "\nError: truncated block.");
+				dec_error( out );
+				break;
+			}
+			write_run( h[0], len );
+			run_blocks++;
+			run_bytes += len;
+		}
+		else if ( h[0] == BLOCK_REF ) {
+			if ( range_mode ) {
+				fprintf(stderr, "\nError: a range cannot take REF blocks; decode the whole file.");
+				dec_error( out );
+				break;
+			}
+			if ( get_bytes( h, 8 ) != 8 ) {
+				fprintf(stderr, "\nError: truncated block.");
+				dec_error( out );
+				break;
+			}
+			/* (the offsets of a member count from its output.) */
+			ref = member_out + (get_le32( h ) | get_le32( h+4 ) << 32);
+			if ( ref + len > nbytes_out + pbuf_count ) {
+				fprintf(stderr, "\nError: reference past the output.");
+				dec_error( out );
+				break;
+			}
+			if ( verify_only ) {
+				/* no output to read back: the data was checked where it was first written. */
+				nbytes_out += len;
+				progress_out( len );
+				io_crc = crc;
+			}
+			else if ( !copy_ref( ref, len ) ) {
+				fprintf(stderr, "\nError: cannot read back the output for a reference"
+					" (the output of --dedup files must be a regular file).");
+				dec_error( out );
+				break;
+			}
+			ref_blocks++;
+			ref_bytes += len;
+		}
+		else {
+			if ( stored > cap ) {
+				if ( (t = (unsigned char *) realloc( blk, stored )) == NULL ) {
+					fprintf(stderr, "\n Error alloc: block buffer.");
+					dec_error( out );
+					break;
+				}
+				blk = t;
+				cap = stored;
+			}
+			if ( get_bytes( blk, stored ) != stored ) {
+				fprintf(stderr, "\nError: truncated block.");
+				dec_error( out );
+				break;
+			}
+			save_gbuf = gbuf;
+			save_end = gbuf_end;
+			gbuf = blk;
+			gbuf_end = blk + stored;
+			dec_in_block = 1;
+			decompress_LZW();
+			dec_in_block = 0;
+			gbuf = save_gbuf;
+			gbuf_end = save_end;
+			if ( nbytes_out + pbuf_count - out != len ) {
+				fprintf(stderr, "\nError: block decoded to %lld bytes, not %lld.",
+					(long long) (nbytes_out + pbuf_count - out), (long long) len );
+				dec_error( out );
+				break;
+			}
+			lzw_blocks++;
+		}
+		if ( crc_writes ) {
+			flush_put_buffer();
+			if ( io_crc != crc ) {
+				fprintf(stderr, "\nError: the block at output bytes %lld..%lld fails its checksum.",
+					(long long) out, (long long) (out + len - 1) );
+				dec_error( out );
+			}
+			data_crc = crc32c_combine( data_crc, io_crc, len );
+		}
+		TRACE_END( "block" );
+	}
+	if ( out_holes ) {
+		/* a hole at the end of the output is not in the file yet. */
+		flush_put_buffer();
+		fflush( pOUT );
+		if ( ftruncate( fileno( pOUT ), ftello( pOUT ) ) != 0 ) {
+			fprintf(stderr, "\nError: cannot extend the output over its last hole.");
+			dec_error( nbytes_out );
+		}
+	}
+	phase_switch( PHASE_OTHER );
+	if ( blk ) free( blk );
+}
+
+/*
+	Reads the checksum after the last code and compares it with that
+	of the data decoded. The decoder stops right after the last code,
+	so the whole bytes left in its bit reservoir come first.
+*/
+static void check_data_crc( void )
+{
+	unsigned char t[ 4 ];
+	int n = 0;
+	uint32_t crc;
+	
+	if ( !block_mode ) {
+		data_crc = io_crc;
+		dec_bitbuf >>= dec_bitcnt & 7;
+		dec_bitcnt &= ~7;
+		for ( ; n < 4 && dec_bitcnt > 0; n++ ) {
+			t[ n ] = (unsigned char) dec_bitbuf;
+			dec_bitbuf >>= 8;
+			dec_bitcnt -= 8;
+		}
+	}
+	if ( get_bytes( t+n, 4-n ) != 4-n ) {
+		fprintf(stderr, "\nError: the checksum of the data is missing (truncated file).");
+		dec_error( nbytes_out );
+		return;
+	}
+	crc = (uint32_t) get_le32( t );
+	if ( crc != data_crc ) {
+		fprintf(stderr, "\nError: the data fails its checksum (CRC32C %08x, the file has %08x).",
+			(unsigned) data_crc, (unsigned) crc );
+		dec_error( -1 );
 	}
 }
@@ -3,12 +3,18 @@
 
 	Filename: LZWHD.C  (the decoder to LZWH.C)
 	
+	lzwhd -t infile tests infile: it is decoded, and checked, without
+	writing any output. The exit status is 1 if the file fails to decode
+	(with or without -t).
+	
 	Gerald R. Tamayo, 2005/2009/2010/2022/2023
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "utypes.h"
 #include "gtbitio2.c"
+#include "lzwhdr.c"
 
 #define CODE_MAX_BITS     16
 #define CODE_MAX        (1<<CODE_MAX_BITS)
@@ -31,10 +37,12 @@
 
 #define get_code() get_nbits( bit_count )
 
-typedef struct {
-	char algorithm[4];
-	int N;
-} file_stamp;
+/* the output of -t. */
+#if defined( _WIN32 )
+	#define NULL_DEVICE    "NUL"
+#else
+	#define NULL_DEVICE    "/dev/null"
+#endif
 
 int code[ HASH_TABLE_SIZE ];
 int prefix[ HASH_TABLE_SIZE ];
@@ -45,63 +53,102 @@ int bit_count = 9;  /* code size starts at 9 bits. */
 int code_max = 512; /* start expanding the code size if we
                          already reached this value. */
 
-unsigned char stack_buffer[ CODE_MAX ], *stack=NULL;
+/* phrase_len[i] = length of the string of code i */
+int phrase_len[ CODE_MAX ];
+
+unsigned char *out, *stack=NULL;
+
+/* bad codes found by the decoder. */
+int decode_errors = 0;
 
 void copyright( void );
+void bad_code( int c );
 
 /*
 	The decompression part does not actually need hashing,
 	so just store the prefix codes and the append characters.
 	
-	even initialization of the code tables is not necessary.
+	even initialization of the code tables is not necessary,
+	except for the string lengths of the single characters.
 */
 void insert_stringDEC( int prefix_code, unsigned char c )
 {
 	prefix[ lzw_code_cnt ] = prefix_code;
 	character[ lzw_code_cnt ] = c;
+	phrase_len[ lzw_code_cnt ] = phrase_len[ prefix_code ] + 1;
 }
 
 int main( int argc, char *argv[] )
 {
-	file_stamp fstamp;
-	int old_lzw_code = 0, new_lzw_code = 0, lzwcode;
-	int N;
+	lzw_header hdr;
+	int old_lzw_code = 0, new_lzw_code = 0, lzwcode, len;
+	int N, test = 0, hsize;
+	int64_t member_at = 0, member_out = 0;
+	const char *in_name, *out_name;
 	
 	if ( argc != 3 ) {
 		fprintf(stderr, "\n Usage: lzwhd infile outfile");
+		fprintf(stderr, "\n        lzwhd -t infile   (test: decode without writing)");
 		copyright();
 		return 0;
 	}
-	if ( (gIN = fopen( argv[1], "rb")) == NULL ) {
+	test = strcmp( argv[1], "-t" ) == 0;
+	in_name = test ? argv[2] : argv[1];
+	out_name = test ? NULL_DEVICE : argv[2];
+	if ( (gIN = fopen( in_name, "rb")) == NULL ) {
 		fprintf(stderr, "\nError opening input file.");
-		return 0;
+		return test;
 	}
-	if ( (pOUT = fopen( argv[2], "wb" )) == NULL ) {
+	if ( (pOUT = fopen( out_name, "wb" )) == NULL ) {
 		fprintf(stderr, "\nError opening output file.");
-		return 0;
+		return test;
 	}
 	init_buffer_sizes(1<<15);
 	init_put_buffer();
 	
-	fprintf(stderr, "\nName of input file : %s", argv[1] );
+	fprintf(stderr, "\nName of input file : %s", in_name );
 	
 	/* start deCompressing to output file. */
-	fprintf(stderr, "\n Decompressing...");
+	fprintf(stderr, test ? "\n Testing..." : "\n Decompressing...");
 
-	/* read the file header, */
-	fread( &fstamp, sizeof( file_stamp ), 1, gIN );
+	/* read the file header (or the old file stamp, N), */
+	if ( !(hsize = hdr_read( gIN, &hdr, 1 )) ) {
+		fprintf(stderr, "\nError: not an LZW file.");
+		decode_errors++;
+		goto done_decompression;
+	}
+	/* each member of files joined with cat (see LZWHDR.H) starts here. */
+	next_member:
+	if ( !hdr_check( &hdr, HDR_LZWH ) ) {
+		decode_errors++;
+		goto done_decompression;
+	}
+	if ( !hdr.legacy && hdr.bits != CODE_MAX_BITS ) {
+		fprintf(stderr, "\nError: a code size of %d bits (this decoder is built for %d).",
+			hdr.bits, CODE_MAX_BITS );
+		decode_errors++;
+		goto done_decompression;
+	}
 	
 	/* and initialize the input buffer. */
 	init_get_buffer();
 	if ( nfread == 0 ) goto done_decompression;
 	
-	N = fstamp.N;
+	N = hdr.legacy ? hdr.legacy_int[ 0 ] : CODE_MAX + (1 << hdr.param);
+	
+	for ( len = 0; len < 256; len++ ) phrase_len[ len ] = 1;
 	
 	/* set the starting code to define. */
 	lzw_code_cnt = START_LZW_CODE;
+	bit_count = 9;
+	code_max = 512;
 	
 	/* get first code. */
 	old_lzw_code = get_nbits( bit_count );
+	if ( old_lzw_code > 255 ) {
+		bad_code( old_lzw_code );
+		goto done_decompression;
+	}
 	
 	/* first code is a character; output it. */
 	pfputc( (unsigned char) old_lzw_code );
@@ -110,29 +157,36 @@ int main( int argc, char *argv[] )
 		new_lzw_code = get_nbits( bit_count );
 		
 		if ( new_lzw_code == EOF_LZW_CODE ) break;
+		else if ( nfread == 0 || new_lzw_code > lzw_code_cnt ) {
+			bad_code( new_lzw_code );
+			break;
+		}
 		else if ( new_lzw_code >= lzw_code_cnt ) lzwcode = old_lzw_code;
 		else lzwcode = new_lzw_code;
 		
-		/* GET STRING/PATTERN. */
-		stack = stack_buffer;
+		/* reserve the string (and K, if undefined code) in the output buffer. */
+		len = phrase_len[ lzwcode ];
+		out = pfreserve( len+1 );
+		
+		/* GET STRING/PATTERN; write it back to front at its final position. */
+		stack = out + len;
 		while ( lzwcode > EOF_LZW_CODE ) {
-			*stack++ = character[ lzwcode ];
+			*--stack = character[ lzwcode ];
 			/* when loop exits, lzwcode must be a character. */
 			lzwcode = prefix[ lzwcode ];
 		}
 		
 		/* K = get first character of string. */
-		*stack = lzwcode;
+		*--stack = lzwcode;
 		
-		/* OUTPUT STRING/PATTERN. */
-		while( stack >= stack_buffer ) {
-			pfputc( *stack-- );
-		}
 		/* if undefined code. */
 		if ( new_lzw_code >= lzw_code_cnt ) {
-			pfputc( lzwcode );
+			out[ len++ ] = lzwcode;
 		}
 		
+		/* OUTPUT STRING/PATTERN. */
+		pfcommit( len );
+		
 		/* add PREV_CODE+K to the string table. */
 		if ( lzw_code_cnt < CODE_MAX ) {
 			insert_stringDEC( old_lzw_code, (unsigned char) lzwcode );
@@ -155,23 +209,54 @@ int main( int argc, char *argv[] )
 			
 			/* get first code. */
 			old_lzw_code = get_nbits( bit_count );
+			if ( old_lzw_code == EOF_LZW_CODE ) break;
+			if ( nfread == 0 || old_lzw_code > 255 ) {
+				bad_code( old_lzw_code );
+				break;
+			}
 			
 			/* first code is a character; output it. */
 			pfputc( (unsigned char) old_lzw_code );
 		}
 	}
 	flush_put_buffer();
+	if ( !hdr_check_size( &hdr, nbytes_out - member_out ) ) decode_errors++;
+	
+	/* the next member, if any. */
+	if ( !decode_errors && !hdr.legacy ) {
+		member_at += hsize + get_nbytes_used();
+		if ( (hsize = hdr_next_member( gIN, member_at, &hdr )) > 0 ) {
+			free_get_buffer();
+			member_out = nbytes_out;
+			goto next_member;
+		}
+		if ( hsize < 0 ) fprintf(stderr, "\nWarning: bytes after the last member, ignored.");
+	}
 	
 	done_decompression:
 	
 	fprintf(stderr, "done.");
-	fprintf(stderr, "\nName of output file: %s\n", argv[2] );
+	if ( test ) fprintf(stderr, "\nTest: %s (%lld bytes decoded)\n",
+		decode_errors ? "FAILED" : "ok", (long long) nbytes_out );
+	else fprintf(stderr, "\nName of output file: %s\n", out_name );
 	
 	free_get_buffer();
 	free_put_buffer();
 	if ( gIN ) fclose( gIN );
 	if ( pOUT ) fclose( pOUT );
-	return 0;
+	return decode_errors != 0;
+}
+
+/*
+	Reports a code that cannot come next in the stream, or the end of
+	the input before the END-of-FILE code, with the output byte there.
+*/
+void bad_code( int c )
+{
+	if ( nfread == 0 ) fprintf(stderr, "\nError: the input ends before the END-of-FILE code, at output byte %lld.",
+		(long long) (nbytes_out + pbuf_count) );
+	else fprintf(stderr, "\nError: bad code %d at output byte %lld.", c, (long long) (nbytes_out + pbuf_count) );
+	decode_errors++;
 }
 
 void copyright( void )
@@ -0,0 +1,217 @@
+/*
+	Filename:  LZWHDR.C
+	
+	The container header shared by the LZW codecs (see LZWHDR.H): it
+	is written byte by byte, so it does not depend on the size or the
+	byte order of int, and it tells which tool wrote the file, with
+	what table and policy, and the size of the data it holds. The old
+	file stamps (a native struct of "LZW" and one or two ints) are
+	still read.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#if defined( __unix__ ) || defined( __APPLE__ )
+	#include <sys/stat.h>
+#endif
+#include "lzwhdr.h"
+
+void put_le( unsigned char *p, uint64_t v, int n )
+{
+	while ( n-- ) {
+		*p++ = (unsigned char) v;
+		v >>= 8;
+	}
+}
+
+uint64_t get_le( const unsigned char *p, int n )
+{
+	uint64_t v = 0;
+	
+	while ( n-- ) v = (v << 8) | p[ n ];
+	return v;
+}
+
+void hdr_init( lzw_header *h, int variant, int policy, int bits, FILE *in )
+{
+#if defined( __unix__ ) || defined( __APPLE__ )
+	struct stat st;
+#endif
+	
+	memset( h, 0, sizeof(lzw_header) );
+	h->version = LZWHDR_VERSION;
+	h->variant = variant;
+	h->policy = policy;
+	h->bits = bits;
+#if defined( __unix__ ) || defined( __APPLE__ )
+	if ( in && fstat( fileno( in ), &st ) == 0 && S_ISREG( st.st_mode ) ) {
+		h->size = (uint64_t) st.st_size;
+		h->flags |= HDR_SIZE;
+	}
+#else
+	(void) in;
+#endif
+}
+
+int hdr_write( FILE *fp, const lzw_header *h )
+{
+	unsigned char b[ LZWHDR_SIZE ];
+	
+	memset( b, 0, sizeof(b) );
+	memcpy( b, LZWHDR_MAGIC, 4 );
+	b[ 4 ] = (unsigned char) h->version;
+	b[ 5 ] = (unsigned char) h->variant;
+	b[ 6 ] = (unsigned char) h->policy;
+	b[ 7 ] = (unsigned char) h->bits;
+	b[ 8 ] = (unsigned char) h->param;
+	b[ 9 ] = (unsigned char) h->flags;
+	put_le( b + 10, LZWHDR_SIZE, 2 );
+	put_le( b + 12, h->table_count, 4 );
+	put_le( b + 16, h->size, 8 );
+	put_le( b + 24, h->table_off, 8 );
+	return fwrite( b, LZWHDR_SIZE, 1, fp ) == 1 ? LZWHDR_SIZE : 0;
+}
+
+int hdr_read( FILE *fp, lzw_header *h, int legacy_ints )
+{
+	unsigned char b[ LZWHDR_SIZE ];
+	int size, i;
+	
+	memset( h, 0, sizeof(lzw_header) );
+	if ( fread( b, 4, 1, fp ) != 1 ) return 0;
+	
+	/* an old file stamp: "LZW" and the native ints. */
+	if ( memcmp( b, "LZW", 4 ) == 0 ) {
+		if ( legacy_ints > 2 ) return 0;
+		for ( i = 0; i < legacy_ints; i++ ) {
+			if ( fread( &h->legacy_int[ i ], sizeof(int), 1, fp ) != 1 ) return 0;
+		}
+		h->legacy = 1;
+		h->bits = h->legacy_int[ 0 ];
+		return 4 + legacy_ints * (int) sizeof(int);
+	}
+	
+	if ( memcmp( b, LZWHDR_MAGIC, 4 ) != 0
+		|| fread( b + 4, LZWHDR_SIZE - 4, 1, fp ) != 1 ) return 0;
+	h->version = b[ 4 ];
+	h->variant = b[ 5 ];
+	h->policy = b[ 6 ];
+	h->bits = b[ 7 ];
+	h->param = b[ 8 ];
+	h->flags = b[ 9 ];
+	size = (int) get_le( b + 10, 2 );
+	h->table_count = (uint32_t) get_le( b + 12, 4 );
+	h->size = get_le( b + 16, 8 );
+	h->table_off = get_le( b + 24, 8 );
+	if ( size < LZWHDR_SIZE ) return 0;
+	
+	/* the fields of a later version. */
+	for ( i = LZWHDR_SIZE; i < size; i++ ) {
+		if ( fgetc( fp ) == EOF ) return 0;
+	}
+	return size;
+}
+
+int hdr_next_member( FILE *fp, int64_t off, lzw_header *h )
+{
+	int c, n;
+	
+#if defined( __unix__ ) || defined( __APPLE__ )
+	if ( fseeko( fp, (off_t) off, SEEK_SET ) != 0 ) return 0;
+#else
+	if ( fseek( fp, (long) off, SEEK_SET ) != 0 ) return 0;
+#endif
+	if ( (c = fgetc( fp )) == EOF ) return 0;
+	ungetc( c, fp );
+	
+	/* (only the first member may be of an old file stamp.) */
+	if ( !(n = hdr_read( fp, h, 0 )) || h->legacy ) return -1;
+	return n;
+}
+
+const char *hdr_variant_name( int variant )
+{
+	switch ( variant ) {
+		case HDR_LZWH:  return "lzwh";
+		case HDR_LZWG:  return "lzwg";
+		case HDR_LZWGT: return "lzwgt";
+		case HDR_LZWZ:  return "lzwz";
+		case HDR_LZWHC: return "lzwhc";
+		default: return "an unknown encoder";
+	}
+}
+
+/*
+	The code sizes and the largest parameter each variant writes;
+	the decoders size their tables from them.
+*/
+static void hdr_ranges( int variant, int *bits_min, int *bits_max, int *param_max )
+{
+	*bits_min = 12;
+	*bits_max = 28;
+	*param_max = 0;
+	if ( variant == HDR_LZWH || variant == HDR_LZWGT ) {
+		/* CODE_MAX_BITS, and n of CODE_MAX+(1<<n). */
+		*bits_max = 16;
+		*param_max = 28;
+	}
+}
+
+int hdr_check( const lzw_header *h, int variant )
+{
+	int bits_min, bits_max, param_max;
+	
+	hdr_ranges( variant, &bits_min, &bits_max, &param_max );
+	if ( h->legacy ) {
+		/* (of the old stamps, only those of lzwg and lzwz give the code size.) */
+		if ( (variant == HDR_LZWG || variant == HDR_LZWZ) && (h->bits < bits_min || h->bits > bits_max) ) {
+			fprintf(stderr, "\nError: not an %s file (code size %d bits).",
+				hdr_variant_name( variant ), h->bits );
+			return 0;
+		}
+		return 1;
+	}
+	if ( h->variant != variant ) {
+		fprintf(stderr, "\nError: the file was written by %s, not %s.",
+			hdr_variant_name( h->variant ), hdr_variant_name( variant ) );
+		return 0;
+	}
+	if ( h->version > LZWHDR_VERSION ) {
+		fprintf(stderr, "\nError: header version %d (this decoder reads %d).",
+			h->version, LZWHDR_VERSION );
+		return 0;
+	}
+	if ( h->bits < bits_min || h->bits > bits_max || h->param < 0 || h->param > param_max ) {
+		fprintf(stderr, "\nError: not an %s file (code size %d bits, parameter %d).",
+			hdr_variant_name( variant ), h->bits, h->param );
+		return 0;
+	}
+	return 1;
+}
+
+int hdr_rewrite( FILE *fp, const lzw_header *h )
+{
+	long long pos;
+	
+	fflush( fp );
+#if defined( __unix__ ) || defined( __APPLE__ )
+	if ( (pos = ftello( fp )) < 0 || fseeko( fp, 0, SEEK_SET ) != 0 ) return 0;
+	hdr_write( fp, h );
+	return fseeko( fp, pos, SEEK_SET ) == 0;
+#else
+	if ( (pos = ftell( fp )) < 0 || fseek( fp, 0, SEEK_SET ) != 0 ) return 0;
+	hdr_write( fp, h );
+	return fseek( fp, (long) pos, SEEK_SET ) == 0;
+#endif
+}
+
+int hdr_check_size( const lzw_header *h, int64_t size )
+{
+	if ( (h->flags & HDR_SIZE) && (uint64_t) size != h->size ) {
+		fprintf(stderr, "\nError: decoded %lld bytes, the header says %lld.",
+			(long long) size, (long long) h->size );
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,110 @@
+/* LZWHDR.H, the portable container header of the LZW codecs, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWHDR_H )
+	#define LZWHDR_H
+
+/*
+	The header, LZWHDR_SIZE bytes, all numbers little-endian:
+	
+	  0  "LZWC"
+	  4  version (LZWHDR_VERSION)
+	  5  codec variant (HDR_LZWH, ...): the tool that wrote the file
+	  6  reset policy (HDR_RESET_BLIND, ...)
+	  7  code size in bits (the largest one)
+	  8  parameter of the variant (lzwh, lzwgt: n of CODE_MAX+(1<<n))
+	  9  flags (HDR_SIZE, ...)
+	 10  header size, 16-bit (later versions may add fields; skip them)
+	 12  entries of the block table, 32-bit
+	 16  uncompressed size, 64-bit (if HDR_SIZE)
+	 24  offset of the block table in the file, 64-bit (if HDR_TABLE)
+	
+	The block table (lzwhc -b) follows the blocks: one entry of
+	HDR_TABLE_ENTRY bytes per block, the input and the file offsets
+	of the block, 64-bit each.
+	
+	With HDR_CRC, the stream ends with the CRC32C of the uncompressed
+	data, 32-bit (before the block table), and each block header of
+	lzwhc -b with the CRC32C of the block.
+	
+	A file may be several members one after the other, as written by
+	cat a.lzw b.lzw > c.lzw: each member is a whole file, with its
+	header, and its offsets (table_off) count from its start. The
+	decoders write the output of each in turn.
+	
+	Files written before the header existed start with "LZW\0" and
+	the native ints of the old file stamp of each tool (legacy).
+*/
+#define LZWHDR_MAGIC       "LZWC"
+#define LZWHDR_VERSION     1
+#define LZWHDR_SIZE        32
+#define HDR_TABLE_ENTRY    16
+
+/* codec variants, by the tool that encodes them. */
+enum { HDR_LZWH = 1, HDR_LZWG, HDR_LZWGT, HDR_LZWZ, HDR_LZWHC };
+
+/* reset policies. */
+enum {
+	HDR_RESET_BLIND,     /* reset after CODE_MAX plus some codes. */
+	HDR_RESET_NONE,      /* the table stays full. */
+	HDR_RESET_CLEAR,     /* CLEAR code when the ratio drops (lzwhc -a). */
+	HDR_RESET_SEGMENTS   /* segments with a header each (lzwhc -m). */
+};
+
+/* flags. */
+#define HDR_SIZE           0x01   /* the uncompressed size is known. */
+#define HDR_BLOCKS         0x02   /* the stream is in blocks (lzwhc -b). */
+#define HDR_TABLE          0x04   /* there is a block table. */
+#define HDR_CRC            0x08   /* CRC32C checksums (lzwhc --crc). */
+
+typedef struct {
+	int version, variant, policy, bits, param, flags;
+	uint32_t table_count;
+	uint64_t size, table_off;
+	
+	/* a legacy file: the ints of its old file stamp. */
+	int legacy;
+	int legacy_int[ 2 ];
+} lzw_header;
+
+/* a header of a variant; the size is that of the input file, if known. */
+void hdr_init( lzw_header *h, int variant, int policy, int bits, FILE *in );
+
+/* writes the header; returns the bytes written, 0 on error. */
+int hdr_write( FILE *fp, const lzw_header *h );
+
+/*
+	Reads the header, or the old file stamp of legacy_ints ints.
+	Returns the bytes read, or 0 if the file has neither.
+*/
+int hdr_read( FILE *fp, lzw_header *h, int legacy_ints );
+
+/*
+	Reads the header of the next member, at offset off of fp (after
+	the end of a member). Returns the bytes read, 0 at the end of the
+	file, or -1 if the bytes there are not a header.
+*/
+int hdr_next_member( FILE *fp, int64_t off, lzw_header *h );
+
+/*
+	Checks that a header read is of the variant of the decoder, and
+	that its code size and parameter are in the range of the variant;
+	prints an error and returns 0 if not.
+*/
+int hdr_check( const lzw_header *h, int variant );
+
+/* writes the header again at the start of fp (seekable files only); returns 1 if done. */
+int hdr_rewrite( FILE *fp, const lzw_header *h );
+
+/* checks the size decoded against the header; prints an error and returns 0 if it differs. */
+int hdr_check_size( const lzw_header *h, int64_t size );
+
+/* the encoder of a variant. */
+const char *hdr_variant_name( int variant );
+
+/* n-byte little-endian numbers (also those of the seek index, LZWIDX.C). */
+void put_le( unsigned char *p, uint64_t v, int n );
+uint64_t get_le( const unsigned char *p, int n );
+
+#endif
@@ -0,0 +1,102 @@
+/*
+	Filename:  LZWIDX.C
+	
+	The sidecar seek index of lzwhc (see LZWIDX.H). A stream can only
+	be decoded from the start of a table (the start of the stream, a
+	reset, a CLEAR code), so the decoder notes the bit offset of each
+	table and the output offset it starts at. To decode a range of
+	the output, the decoder then starts at the last table before it,
+	and stops once it is past its end.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include "lzwidx.h"
+#include "lzwhdr.h"  /* put_le(), get_le() */
+
+int idx_add( lzw_index *x, uint64_t bit_off, uint64_t out_off, int state )
+{
+	idx_entry *e;
+	
+	if ( x->n == x->cap ) {
+		x->cap = x->cap ? 2*x->cap : 1024;
+		if ( (e = (idx_entry *) realloc( x->e, sizeof(idx_entry) * x->cap )) == NULL ) return 0;
+		x->e = e;
+	}
+	x->e[ x->n ].bit_off = bit_off;
+	x->e[ x->n ].out_off = out_off;
+	x->e[ x->n ].state = state;
+	x->n++;
+	return 1;
+}
+
+int idx_write( const char *name, const lzw_index *x )
+{
+	unsigned char b[ LZWIDX_SIZE ];
+	FILE *fp;
+	size_t i;
+	int ok;
+	
+	if ( (fp = fopen( name, "wb" )) == NULL ) return 0;
+	memset( b, 0, sizeof(b) );
+	memcpy( b, LZWIDX_MAGIC, 4 );
+	b[ 4 ] = LZWIDX_VERSION;
+	put_le( b + 8, x->n, 8 );
+	put_le( b + 16, x->file_size, 8 );
+	put_le( b + 24, x->data_size, 8 );
+	ok = fwrite( b, LZWIDX_SIZE, 1, fp ) == 1;
+	for ( i = 0; ok && i < x->n; i++ ) {
+		put_le( b, x->e[ i ].bit_off | (uint64_t) x->e[ i ].state << 56, 8 );
+		put_le( b + 8, x->e[ i ].out_off, 8 );
+		ok = fwrite( b, LZWIDX_ENTRY, 1, fp ) == 1;
+	}
+	if ( fclose( fp ) != 0 ) ok = 0;
+	return ok;
+}
+
+int idx_read( const char *name, lzw_index *x )
+{
+	unsigned char b[ LZWIDX_SIZE ];
+	FILE *fp;
+	uint64_t n, i, w;
+	
+	memset( x, 0, sizeof(lzw_index) );
+	if ( (fp = fopen( name, "rb" )) == NULL ) return 0;
+	if ( fread( b, LZWIDX_SIZE, 1, fp ) != 1 || memcmp( b, LZWIDX_MAGIC, 4 ) != 0
+		|| b[ 4 ] != LZWIDX_VERSION ) goto bad;
+	n = get_le( b + 8, 8 );
+	x->file_size = get_le( b + 16, 8 );
+	x->data_size = get_le( b + 24, 8 );
+	for ( i = 0; i < n; i++ ) {
+		if ( fread( b, LZWIDX_ENTRY, 1, fp ) != 1 ) goto bad;
+		w = get_le( b, 8 );
+		if ( !idx_add( x, w & (((uint64_t) 1 << 56) - 1), get_le( b + 8, 8 ), (int) (w >> 56) ) ) goto bad;
+	}
+	fclose( fp );
+	return 1;
+	
+	bad:
+	fclose( fp );
+	idx_free( x );
+	return 0;
+}
+
+const idx_entry *idx_find( const lzw_index *x, uint64_t off )
+{
+	size_t lo = 0, hi = x->n, mid;
+	
+	/* the entries are in output order: the first one past off is at hi. */
+	while ( lo < hi ) {
+		mid = lo + (hi - lo) / 2;
+		if ( x->e[ mid ].out_off <= off ) lo = mid + 1;
+		else hi = mid;
+	}
+	return hi ? &x->e[ hi-1 ] : NULL;
+}
+
+void idx_free( lzw_index *x )
+{
+	if ( x->e ) free( x->e );
+	memset( x, 0, sizeof(lzw_index) );
+}
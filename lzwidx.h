@@ -0,0 +1,56 @@
+/* LZWIDX.H, the sidecar seek index of LZWHC files, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+#include <stddef.h>
+
+#if !defined( LZWIDX_H )
+	#define LZWIDX_H
+
+/*
+	The index of a stream (lzwhc -d --index) is a file of its own, all
+	numbers little-endian:
+	
+	  0  "LZWI"
+	  4  version (LZWIDX_VERSION), then 3 bytes of zeros
+	  8  entries, 64-bit
+	 16  size of the compressed file, 64-bit
+	 24  uncompressed size, 64-bit
+	 32  the entries, LZWIDX_ENTRY bytes each: the bit offset in the
+	     compressed file where a table starts (56 bits) and the state of
+	     the decoder there (8 bits), then the output offset, 64-bit.
+	
+	The state is 0 at a point where the decoder starts as at the start
+	of the stream; in a segment of the max mode (after a blind reset),
+	it is the header of the segment (LZWMAX.H).
+*/
+#define LZWIDX_MAGIC       "LZWI"
+#define LZWIDX_VERSION     1
+#define LZWIDX_SIZE        32
+#define LZWIDX_ENTRY       16
+
+typedef struct {
+	uint64_t bit_off, out_off;
+	int state;
+} idx_entry;
+
+typedef struct {
+	uint64_t file_size, data_size;
+	idx_entry *e;
+	size_t n, cap;
+} lzw_index;
+
+/* adds an entry; returns 0 if out of memory. */
+int idx_add( lzw_index *x, uint64_t bit_off, uint64_t out_off, int state );
+
+/* writes the index to the file name; returns 0 on error. */
+int idx_write( const char *name, const lzw_index *x );
+
+/* reads the index from the file name; returns 0 if it cannot (no file, not an index). */
+int idx_read( const char *name, lzw_index *x );
+
+/* the last entry at or before output offset off, or NULL if there is none. */
+const idx_entry *idx_find( const lzw_index *x, uint64_t off );
+
+void idx_free( lzw_index *x );
+
+#endif
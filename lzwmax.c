@@ -0,0 +1,195 @@
+/*
+	Filename:  LZWMAX.C
+	
+	The segment search of the max mode (lzwhc -m), for data that is
+	compressed once and read many times.
+	
+	The input is cut into chunks of MAX_CHUNK_SIZE bytes. For each
+	chunk and each candidate table (a code size, with blind resets or
+	a table that stays full), a segment starting at that chunk is
+	compressed with the LZW kernel, and its exact size in bits is
+	noted at every chunk boundary it passes, up to MAX_SEG_CHUNKS
+	chunks. These trial runs are independent and are shared by all
+	the threads. A dynamic program then picks the segments (the
+	places where the table is cleared) and the table of each segment
+	with the smallest total size.
+	
+	The whole input is in memory. Needs POSIX threads (link with
+	-lpthread).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <pthread.h>
+#include <unistd.h>
+#include "lzwenc.h"
+#include "lzwtrace.h"
+#include "lzwmax.h"
+
+#define MAX_NCODES   (1<<16)
+
+__thread int max_worker = 0;
+
+/* the trial runs shared by the threads. */
+static struct {
+	const unsigned char *buf;
+	int64_t size;
+	int nchunks, ncand;
+	int cand_bits[ 2*MAX_SEARCH_BITS ], cand_blind[ 2*MAX_SEARCH_BITS ];
+	
+	/*
+		cost[ (i*MAX_SEG_CHUNKS + k)*ncand + c ] is the size in bits
+		of chunks i..i+k as one segment with candidate c; -1 if not
+		tried.
+	*/
+	int64_t *cost;
+	int next_task;
+	int failed;
+} job;
+
+/*
+	The trial run of candidate c from chunk i: notes the size of the
+	segment ending at each chunk boundary, with its header, its last
+	string and the CLEAR (or EOF) code.
+*/
+static void try_segments( lzw_dict *d, uint32_t *out, int i, int c )
+{
+	const unsigned char *p = job.buf + (int64_t) i * MAX_CHUNK_SIZE, *end;
+	int64_t bits = MAX_HEADER_BITS;
+	int64_t *cost = job.cost + (int64_t) i * MAX_SEG_CHUNKS * job.ncand + c;
+	int k, len, width = 9;
+	size_t n;
+	
+	len = job.cand_blind[ c ] ? MAX_BLIND_CHUNKS : MAX_SEG_CHUNKS;
+	if ( len > job.nchunks - i ) len = job.nchunks - i;
+	
+	lzw_dict_use_segments( d, job.cand_blind[ c ] );
+	lzw_dict_init( d );
+	for ( k = 0; k < len; k++ ) {
+		end = job.buf + (int64_t) (i+k+1) * MAX_CHUNK_SIZE;
+		if ( end > job.buf + job.size ) end = job.buf + job.size;
+		while ( p < end ) {
+			n = lzw_match( d, &p, end, out, MAX_NCODES );
+			bits += lzw_count_bits( out, n, &width );
+		}
+		cost[ (int64_t) k * job.ncand ] = bits + 2 * d->bit_count;
+	}
+}
+
+static void *search_thread( void *arg )
+{
+	lzw_dict dicts[ MAX_SEARCH_BITS+1 ];
+	uint32_t *out;
+	lzw_dict *d;
+	int t, i;
+	
+	(void) arg;
+	max_worker = 1;
+	trace_thread_name( "search" );
+	memset( dicts, 0, sizeof(dicts) );
+	if ( (out = (uint32_t *) malloc( sizeof(uint32_t) * MAX_NCODES )) == NULL ) {
+		job.failed = 1;
+		return NULL;
+	}
+	while ( (t = __atomic_fetch_add( &job.next_task, 1, __ATOMIC_RELAXED ))
+			< job.nchunks * job.ncand ) {
+		d = &dicts[ job.cand_bits[ t % job.ncand ] ];
+		if ( !d->code && !lzw_dict_alloc( d, job.cand_bits[ t % job.ncand ] ) ) {
+			job.failed = 1;
+			break;
+		}
+		TRACE_BEGIN( "trial" );
+		try_segments( d, out, t / job.ncand, t % job.ncand );
+		TRACE_END( "trial" );
+	}
+	for ( i = 0; i <= MAX_SEARCH_BITS; i++ ) lzw_dict_free( &dicts[ i ] );
+	free( out );
+	return NULL;
+}
+
+int max_search( const unsigned char *buf, int64_t size, int max_bits,
+	int nthreads, max_segment **segs )
+{
+	pthread_t *threads;
+	int64_t *best, v;
+	int *from, *pick;
+	int i, j, k, c, n, nseg = 0, top;
+	
+	memset( &job, 0, sizeof(job) );
+	job.buf = buf;
+	job.size = size;
+	job.nchunks = (int) ((size + MAX_CHUNK_SIZE - 1) / MAX_CHUNK_SIZE);
+	
+	/* the candidates: code sizes 12, 14, ... and max_bits, with each policy. */
+	top = max_bits < MAX_SEARCH_BITS ? max_bits : MAX_SEARCH_BITS;
+	for ( n = 12; n <= top; n++ ) {
+		if ( (n & 1) && n != top ) continue;
+		for ( k = 1; k >= 0; k-- ) {
+			job.cand_bits[ job.ncand ] = n;
+			job.cand_blind[ job.ncand++ ] = k;
+		}
+	}
+	
+	n = job.nchunks * MAX_SEG_CHUNKS * job.ncand;
+	job.cost = (int64_t *) malloc( sizeof(int64_t) * n );
+	best = (int64_t *) malloc( sizeof(int64_t) * (job.nchunks+1) );
+	from = (int *) malloc( sizeof(int) * (job.nchunks+1) );
+	pick = (int *) malloc( sizeof(int) * (job.nchunks+1) );
+	if ( nthreads <= 0 ) nthreads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+	if ( nthreads <= 0 ) nthreads = 1;
+	threads = (pthread_t *) malloc( sizeof(pthread_t) * nthreads );
+	*segs = NULL;
+	if ( !job.cost || !best || !from || !pick || !threads ) goto done;
+	for ( i = 0; i < n; i++ ) job.cost[ i ] = -1;
+	
+	/* the trial runs. */
+	for ( i = 0; i < nthreads; i++ ) {
+		if ( pthread_create( &threads[ i ], NULL, search_thread, NULL ) != 0 ) break;
+	}
+	if ( i == 0 ) search_thread( NULL );
+	nthreads = i;
+	for ( i = 0; i < nthreads; i++ ) pthread_join( threads[ i ], NULL );
+	max_worker = 0;
+	if ( job.failed ) goto done;
+	
+	/* best[ j ] = the smallest size of chunks 0..j-1, whose last segment starts at from[ j ]. */
+	best[ 0 ] = 0;
+	for ( j = 1; j <= job.nchunks; j++ ) {
+		best[ j ] = INT64_MAX;
+		for ( k = 1; k <= MAX_SEG_CHUNKS && k <= j; k++ ) {
+			i = j - k;
+			for ( c = 0; c < job.ncand; c++ ) {
+				v = job.cost[ ((int64_t) i * MAX_SEG_CHUNKS + k-1) * job.ncand + c ];
+				if ( v >= 0 && best[ i ] + v < best[ j ] ) {
+					best[ j ] = best[ i ] + v;
+					from[ j ] = i;
+					pick[ j ] = c;
+				}
+			}
+		}
+	}
+	
+	/* the segments, last to first. */
+	for ( j = job.nchunks; j > 0; j = from[ j ] ) nseg++;
+	if ( (*segs = (max_segment *) malloc( sizeof(max_segment) * nseg )) == NULL ) {
+		nseg = 0;
+		goto done;
+	}
+	for ( k = nseg, j = job.nchunks; j > 0; j = from[ j ] ) {
+		k--;
+		(*segs)[ k ].start = (int64_t) from[ j ] * MAX_CHUNK_SIZE;
+		(*segs)[ k ].end = (int64_t) j * MAX_CHUNK_SIZE;
+		if ( (*segs)[ k ].end > size ) (*segs)[ k ].end = size;
+		(*segs)[ k ].bits = job.cand_bits[ pick[ j ] ];
+		(*segs)[ k ].blind = job.cand_blind[ pick[ j ] ];
+	}
+	
+	done:
+	if ( job.cost ) free( job.cost );
+	if ( best ) free( best );
+	if ( from ) free( from );
+	if ( pick ) free( pick );
+	if ( threads ) free( threads );
+	return nseg;
+}
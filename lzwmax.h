@@ -0,0 +1,48 @@
+/* LZWMAX.H, the segment search of the max mode of LZWHC, 2024 */
+#include <stdint.h>  /* C99 */
+#include "lzwenc.h"
+
+#if !defined( LZWMAX_H )
+	#define LZWMAX_H
+
+/*
+	In the max mode, each segment of the stream starts with a header
+	of MAX_HEADER_BITS bits: the code size of its table in the low
+	5 bits, plus MAX_HEADER_BLIND if the table is reset after
+	CODE_MAX+4K codes (otherwise it stays full). A segment ends with
+	CLEAR_LZW_CODE, the last one with EOF_LZW_CODE.
+*/
+#define MAX_HEADER_BITS    6
+#define MAX_HEADER_SIZE    0x1f
+#define MAX_HEADER_BLIND   0x20
+
+/* the input is cut into chunks; segments start and end at chunk boundaries. */
+#define MAX_CHUNK_SIZE     (128<<10)
+
+/* longest segment searched, in chunks: full table, and blind resets. */
+#define MAX_SEG_CHUNKS     32
+#define MAX_BLIND_CHUNKS   8
+
+/* largest code size searched; a 4MB segment cannot fill a bigger table. */
+#define MAX_SEARCH_BITS    20
+
+typedef struct {
+	int64_t start, end;       /* input bytes of the segment. */
+	int bits;                 /* code size of its table. */
+	int blind;                /* 1 = blind resets, 0 = the table stays full. */
+} max_segment;
+
+/* nonzero in the threads of the searches of -m and --auto, and of the block coders (their table resets are not timed). */
+extern __thread int max_worker;
+
+/*
+	Finds the segments of buf[0..size-1] and their code sizes, up to
+	max_bits, that give the smallest output; uses nthreads threads
+	(0 = one per processor).
+	Returns the number of segments, stored in *segs (free() it), or 0
+	if out of memory.
+*/
+int max_search( const unsigned char *buf, int64_t size, int max_bits,
+	int nthreads, max_segment **segs );
+
+#endif
@@ -0,0 +1,141 @@
+/*
+	Filename:  LZWPERF.C
+	
+	Hardware performance counters (Linux perf_event_open) around
+	the compress or decompress phase of a codec (--perf): cycles,
+	instructions, L1D/LLC/dTLB read misses and branch misses.
+	Counts are scaled when the kernel multiplexes the counters.
+	The counters are inherited by the threads started after perf_open()
+	(the searches of -m, the block coders of -b), whose counts are
+	added when they end. On other systems, or without permission,
+	nothing is counted.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#if defined( __linux__ )
+	#include <unistd.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+#include "lzwperf.h"
+
+static const char *perf_names[ NPERF ] = {
+	"cycles", "instructions", "L1D misses", "LLC misses", "dTLB misses", "branch misses"
+};
+
+static int perf_fd[ NPERF ] = { -1, -1, -1, -1, -1, -1 };
+static uint64_t perf_count[ NPERF ];
+
+#if defined( __linux__ )
+#define HW_CACHE_READ_MISS(c)  ((c) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+	(PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static int open_counter( uint32_t type, uint64_t config )
+{
+	struct perf_event_attr pe;
+	
+	memset( &pe, 0, sizeof(pe) );
+	pe.type = type;
+	pe.size = sizeof(pe);
+	pe.config = config;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+	pe.inherit = 1;
+	pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int) syscall( __NR_perf_event_open, &pe, 0, -1, -1, 0 );
+}
+#endif
+
+int perf_open( void )
+{
+	int i, n = 0;
+	
+#if defined( __linux__ )
+	perf_fd[ PERF_CYCLES ] = open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+	perf_fd[ PERF_INSTRUCTIONS ] = open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS );
+	perf_fd[ PERF_L1D_MISSES ] = open_counter( PERF_TYPE_HW_CACHE,
+		HW_CACHE_READ_MISS( PERF_COUNT_HW_CACHE_L1D ) );
+	perf_fd[ PERF_LLC_MISSES ] = open_counter( PERF_TYPE_HW_CACHE,
+		HW_CACHE_READ_MISS( PERF_COUNT_HW_CACHE_LL ) );
+	perf_fd[ PERF_DTLB_MISSES ] = open_counter( PERF_TYPE_HW_CACHE,
+		HW_CACHE_READ_MISS( PERF_COUNT_HW_CACHE_DTLB ) );
+	perf_fd[ PERF_BRANCH_MISSES ] = open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES );
+#endif
+	for ( i = 0; i < NPERF; i++ ) {
+		perf_count[ i ] = 0;
+		if ( perf_fd[ i ] >= 0 ) n++;
+	}
+	return n;
+}
+
+void perf_start( void )
+{
+#if defined( __linux__ )
+	int i;
+	
+	for ( i = 0; i < NPERF; i++ ) {
+		if ( perf_fd[ i ] < 0 ) continue;
+		ioctl( perf_fd[ i ], PERF_EVENT_IOC_RESET, 0 );
+		ioctl( perf_fd[ i ], PERF_EVENT_IOC_ENABLE, 0 );
+	}
+#endif
+}
+
+void perf_stop( void )
+{
+#if defined( __linux__ )
+	/* value, time enabled, time running. */
+	uint64_t v[ 3 ];
+	int i;
+	
+	for ( i = 0; i < NPERF; i++ ) {
+		if ( perf_fd[ i ] < 0 ) continue;
+		ioctl( perf_fd[ i ], PERF_EVENT_IOC_DISABLE, 0 );
+		if ( read( perf_fd[ i ], v, sizeof(v) ) != sizeof(v) || v[ 2 ] == 0 ) {
+			close( perf_fd[ i ] );
+			perf_fd[ i ] = -1;
+			continue;
+		}
+		perf_count[ i ] = v[ 2 ] < v[ 1 ] ?
+			(uint64_t) ((double) v[ 0 ] * v[ 1 ] / v[ 2 ]) : v[ 0 ];
+	}
+#endif
+}
+
+void perf_close( void )
+{
+	int i;
+	
+	for ( i = 0; i < NPERF; i++ ) {
+#if defined( __linux__ )
+		if ( perf_fd[ i ] >= 0 ) close( perf_fd[ i ] );
+#endif
+		perf_fd[ i ] = -1;
+	}
+}
+
+void perf_report( FILE *fp, const char *name, int64_t bytes, int64_t codes )
+{
+	int i, n = 0;
+	
+	fprintf(fp, "\n---- performance counters (%s) ----", name );
+	for ( i = 0; i < NPERF; i++ ) {
+		if ( perf_fd[ i ] < 0 ) continue;
+		fprintf(fp, "\n%-14s %15llu %10.3f /byte %10.3f /code", perf_names[ i ],
+			(unsigned long long) perf_count[ i ],
+			bytes ? (double) perf_count[ i ] / bytes : 0.0,
+			codes ? (double) perf_count[ i ] / codes : 0.0 );
+		n++;
+	}
+	if ( n == 0 ) fprintf(fp, "\nnot available on this system.");
+	else if ( perf_fd[ PERF_CYCLES ] >= 0 && perf_fd[ PERF_INSTRUCTIONS ] >= 0
+		&& perf_count[ PERF_CYCLES ] ) {
+		fprintf(fp, "\ninstructions per cycle = %.3f",
+			(double) perf_count[ PERF_INSTRUCTIONS ] / perf_count[ PERF_CYCLES ] );
+	}
+	fprintf(fp, "\n");
+}
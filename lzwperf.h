@@ -0,0 +1,32 @@
+/* LZWPERF.H, hardware performance counters of a codec run, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWPERF_H )
+	#define LZWPERF_H
+
+enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_BRANCH_MISSES,
+	NPERF
+};
+
+/*
+	Opens the counters of this process (and of the threads it starts
+	afterwards); returns the number opened.
+	Counters the kernel or the CPU does not provide (e.g. in
+	containers or virtual machines) are left out of the report.
+*/
+int  perf_open( void );
+void perf_start( void );
+void perf_stop( void );
+void perf_close( void );
+
+/* prints the counts, per input byte and per code, of the phase name. */
+void perf_report( FILE *fp, const char *name, int64_t bytes, int64_t codes );
+
+#endif
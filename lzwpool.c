@@ -0,0 +1,134 @@
+/*
+	Filename:  LZWPOOL.C
+	
+	The worker threads of the block mode of lzwhc: they are started
+	once, and take the jobs of a queue in the order they were given
+	while the caller goes on reading and queueing. The caller gets
+	the jobs back in that order too (pool_wait()), so whatever it
+	writes from them is in the order of the input, however the
+	workers finish. A job that no worker has taken yet when the
+	caller waits for it is run by the caller itself.
+	
+	Needs POSIX threads (link with -lpthread).
+	*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <pthread.h>
+#include "lzwtrace.h"
+#include "lzwpool.h"
+
+/* at most this many workers. */
+#define POOL_MAX_THREADS  256
+
+/* a job of the queue: waiting, taken by a worker, or done. */
+enum { JOB_QUEUED, JOB_TAKEN, JOB_DONE };
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t queued, done;   /* a job was queued; a job is done. */
+	pthread_t threads[ POOL_MAX_THREADS ];
+	int nthreads, stopping;
+	pool_work work;
+	
+	/* the queue: jobs first..end-1, of which next..end-1 are not taken yet. */
+	void **job;
+	int *state;
+	int cap;
+	int64_t first, next, end;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void *pool_thread( void *arg )
+{
+	int worker = (int) (intptr_t) arg, i;
+	
+	trace_thread_name( "block" );
+	pthread_mutex_lock( &pool.lock );
+	while ( 1 ) {
+		while ( pool.next == pool.end && !pool.stopping ) pthread_cond_wait( &pool.queued, &pool.lock );
+		if ( pool.stopping ) break;
+		i = (int) (pool.next++ % pool.cap);
+		pool.state[ i ] = JOB_TAKEN;
+		pthread_mutex_unlock( &pool.lock );
+		pool.work( pool.job[ i ], worker );
+		pthread_mutex_lock( &pool.lock );
+		pool.state[ i ] = JOB_DONE;
+		pthread_cond_broadcast( &pool.done );
+	}
+	pthread_mutex_unlock( &pool.lock );
+	return NULL;
+}
+
+int pool_start( int nthreads, int max_jobs, pool_work work )
+{
+	int i;
+	
+	pool.job = (void **) malloc( sizeof(void *) * max_jobs );
+	pool.state = (int *) malloc( sizeof(int) * max_jobs );
+	if ( !pool.job || !pool.state ) return -1;
+	pool.cap = max_jobs;
+	pool.work = work;
+	pool.first = pool.next = pool.end = 0;
+	pool.stopping = 0;
+	if ( nthreads > POOL_MAX_THREADS ) nthreads = POOL_MAX_THREADS;
+	for ( i = 0; i < nthreads; i++ ) {
+		if ( pthread_create( &pool.threads[ i ], NULL, pool_thread, (void *) (intptr_t) (i+1) ) != 0 ) break;
+	}
+	return pool.nthreads = i;
+}
+
+void pool_submit( void *job )
+{
+	int i;
+	
+	pthread_mutex_lock( &pool.lock );
+	i = (int) (pool.end++ % pool.cap);
+	pool.job[ i ] = job;
+	pool.state[ i ] = JOB_QUEUED;
+	pthread_cond_signal( &pool.queued );
+	pthread_mutex_unlock( &pool.lock );
+}
+
+void *pool_wait( void )
+{
+	void *job;
+	int i;
+	
+	pthread_mutex_lock( &pool.lock );
+	if ( pool.first == pool.end ) {
+		pthread_mutex_unlock( &pool.lock );
+		return NULL;
+	}
+	i = (int) (pool.first % pool.cap);
+	if ( pool.next == pool.first ) {
+		/* no worker took it: the caller runs it. */
+		pool.next++;
+		pool.state[ i ] = JOB_TAKEN;
+		pthread_mutex_unlock( &pool.lock );
+		pool.work( pool.job[ i ], 0 );
+		pthread_mutex_lock( &pool.lock );
+		pool.state[ i ] = JOB_DONE;
+	}
+	while ( pool.state[ i ] != JOB_DONE ) pthread_cond_wait( &pool.done, &pool.lock );
+	job = pool.job[ i ];
+	pool.first++;
+	pthread_mutex_unlock( &pool.lock );
+	return job;
+}
+
+void pool_stop( void )
+{
+	int i;
+	
+	pthread_mutex_lock( &pool.lock );
+	pool.stopping = 1;
+	pthread_cond_broadcast( &pool.queued );
+	pthread_mutex_unlock( &pool.lock );
+	for ( i = 0; i < pool.nthreads; i++ ) pthread_join( pool.threads[ i ], NULL );
+	pool.nthreads = 0;
+	free( pool.job );
+	free( pool.state );
+	pool.job = NULL;
+	pool.state = NULL;
+}
@@ -0,0 +1,31 @@
+/* LZWPOOL.H, the worker threads of the block mode of LZWHC, 2024 */
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWPOOL_H )
+	#define LZWPOOL_H
+
+/* the work on a job, by worker 1..n of the pool, or 0 (the caller of pool_wait()). */
+typedef void (*pool_work)( void *job, int worker );
+
+/*
+	Starts the pool: up to nthreads worker threads (as many as can
+	be started) that run work() on the queued jobs, oldest first.
+	Returns the number of workers, or -1 if out of memory. With no
+	workers, pool_wait() does all the work.
+*/
+int  pool_start( int nthreads, int max_jobs, pool_work work );
+
+/* queues a job; at most max_jobs may be queued and not yet returned by pool_wait(). */
+void pool_submit( void *job );
+
+/*
+	Waits for the oldest job and returns it, in the order of
+	pool_submit(); a job that no worker took yet is run by the
+	caller. Returns NULL if there is none.
+*/
+void *pool_wait( void );
+
+/* stops the workers; the jobs still queued are dropped. */
+void pool_stop( void );
+
+#endif
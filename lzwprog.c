@@ -0,0 +1,130 @@
+/*
+	Filename:  LZWPROG.C
+	
+	Progress of a long run (--progress, --status): a separate thread
+	wakes up at a fixed interval and reports the rate, the ratio so
+	far and the estimated time left, from byte counters the codec
+	updates once per buffer. Nothing is added to the per-byte loops.
+	
+	Needs POSIX threads (link with -lpthread).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <time.h>
+#include <pthread.h>
+#include "lzwprog.h"
+
+int64_t prog_bytes_in = 0, prog_bytes_out = 0;
+
+static pthread_t prog_thread;
+static pthread_mutex_t prog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prog_cond = PTHREAD_COND_INITIALIZER;
+static int prog_running = 0, prog_stopping = 0, prog_print;
+static double prog_interval, prog_t0;
+static const char *prog_status_file;
+static int64_t prog_total_in;
+
+static double prog_clock( void )
+{
+	struct timespec ts;
+	
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void progress_update( int last )
+{
+	int64_t in = __atomic_load_n( &prog_bytes_in, __ATOMIC_RELAXED );
+	int64_t out = __atomic_load_n( &prog_bytes_out, __ATOMIC_RELAXED );
+	double secs = prog_clock() - prog_t0, rate = 0, eta = -1, ratio = 0, pct = -1;
+	char tmpname[ 1024 ];
+	FILE *fp;
+	
+	if ( secs > 0 ) rate = in / secs;
+	if ( in > 0 ) ratio = (double) out / in;
+	if ( prog_total_in > 0 ) {
+		pct = 100.0 * in / prog_total_in;
+		if ( rate > 0 ) eta = (prog_total_in - in) / rate;
+		if ( eta < 0 ) eta = 0;
+	}
+	if ( prog_print ) {
+		if ( pct >= 0 ) fprintf(stderr, "\r %6.2f%%", pct );
+		else fprintf(stderr, "\r ");
+		fprintf(stderr, " %10.1f MB in, %10.1f MB out, %8.2f MB/s, ratio %6.4f",
+			in / 1048576.0, out / 1048576.0, rate / 1048576.0, ratio );
+		if ( eta >= 0 ) fprintf(stderr, ", ETA %d:%02d:%02d ",
+			(int) eta / 3600, ((int) eta / 60) % 60, (int) eta % 60 );
+		if ( last ) fprintf(stderr, "\n");
+		fflush( stderr );
+	}
+	if ( prog_status_file ) {
+		/* write a new file and rename it, so readers never see half of it. */
+		snprintf( tmpname, sizeof(tmpname), "%s.tmp", prog_status_file );
+		if ( (fp = fopen( tmpname, "w" )) == NULL ) return;
+		fprintf(fp, "{\"bytes_in\":%lld,\"bytes_out\":%lld,\"total_in\":%lld,"
+			"\"seconds\":%.3f,\"mb_per_s\":%.3f,\"ratio\":%.6f,\"percent\":%.3f,"
+			"\"eta_seconds\":%.1f,\"done\":%s}\n",
+			(long long) in, (long long) out, (long long) prog_total_in, secs,
+			rate / 1048576.0, ratio, pct, eta, last ? "true" : "false" );
+		fclose( fp );
+		rename( tmpname, prog_status_file );
+	}
+}
+
+static void *progress_thread( void *arg )
+{
+	struct timespec ts;
+	double next = prog_t0;
+	
+	pthread_mutex_lock( &prog_mutex );
+	while ( !prog_stopping ) {
+		next += prog_interval;
+		ts.tv_sec = (time_t) next;
+		ts.tv_nsec = (long) ((next - ts.tv_sec) * 1e9);
+		/* the condition variable uses CLOCK_MONOTONIC (see progress_start()). */
+		while ( !prog_stopping && pthread_cond_timedwait( &prog_cond, &prog_mutex, &ts ) == 0 )
+			;
+		if ( prog_stopping ) break;
+		pthread_mutex_unlock( &prog_mutex );
+		progress_update( 0 );
+		pthread_mutex_lock( &prog_mutex );
+	}
+	pthread_mutex_unlock( &prog_mutex );
+	return arg;
+}
+
+int progress_start( double interval, int print, const char *status_file, int64_t total_in )
+{
+	pthread_condattr_t ca;
+	
+	if ( prog_running || interval <= 0 ) return 0;
+	prog_interval = interval;
+	prog_print = print;
+	prog_status_file = status_file;
+	prog_total_in = total_in;
+	prog_stopping = 0;
+	prog_t0 = prog_clock();
+	
+	pthread_condattr_init( &ca );
+	pthread_condattr_setclock( &ca, CLOCK_MONOTONIC );
+	pthread_cond_init( &prog_cond, &ca );
+	pthread_condattr_destroy( &ca );
+	
+	if ( pthread_create( &prog_thread, NULL, progress_thread, NULL ) != 0 ) return 0;
+	prog_running = 1;
+	return 1;
+}
+
+void progress_stop( void )
+{
+	if ( !prog_running ) return;
+	pthread_mutex_lock( &prog_mutex );
+	prog_stopping = 1;
+	pthread_cond_signal( &prog_cond );
+	pthread_mutex_unlock( &prog_mutex );
+	pthread_join( prog_thread, NULL );
+	prog_running = 0;
+	progress_update( 1 );
+}
@@ -0,0 +1,29 @@
+/* LZWPROG.H, progress of a long codec run from a separate thread, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWPROG_H )
+	#define LZWPROG_H
+
+/*
+	The byte counters read by the progress thread. The codec adds to
+	them once per buffer refill or flush, never per byte.
+*/
+extern int64_t prog_bytes_in, prog_bytes_out;
+
+#define progress_in( n )   __atomic_fetch_add( &prog_bytes_in, (int64_t) (n), __ATOMIC_RELAXED )
+#define progress_out( n )  __atomic_fetch_add( &prog_bytes_out, (int64_t) (n), __ATOMIC_RELAXED )
+
+/*
+	Starts the progress thread. Every interval seconds it prints the
+	bytes done, the rate, the ratio so far and the ETA on stderr
+	(if print is nonzero), and rewrites status_file (if not NULL) as
+	one line of JSON. total_in is the input file size, or 0 if not
+	known. Returns 0 if the thread cannot be started.
+*/
+int  progress_start( double interval, int print, const char *status_file, int64_t total_in );
+
+/* stops the thread after a last update. */
+void progress_stop( void );
+
+#endif
@@ -0,0 +1,107 @@
+/*
+	Filename:  LZWRUN.C
+	
+	Wall-clock phase timers and run statistics of the codecs:
+	the time of each phase (read, match, pack, write, reset...)
+	and a machine-readable summary of the run (--stats=json).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <time.h>
+#if defined( __unix__ ) || defined( __APPLE__ )
+	#include <sys/time.h>
+	#include <sys/resource.h>
+#endif
+#include "lzwrun.h"
+
+const char *phase_names[ NPHASES ] = {
+	"other", "read", "match", "pack", "decode", "write", "reset", "search", "scan", "dedup", "check", "free"
+};
+double phase_time[ NPHASES ];
+int cur_phase = PHASE_OTHER;
+
+static double run_start_time = 0, phase_start_time = 0;
+
+double wall_time( void )
+{
+#if defined( CLOCK_MONOTONIC )
+	struct timespec ts;
+	
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+	return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void run_start( void )
+{
+	memset( phase_time, 0, sizeof(phase_time) );
+	cur_phase = PHASE_OTHER;
+	run_start_time = phase_start_time = wall_time();
+}
+
+double run_time( void )
+{
+	return wall_time() - run_start_time;
+}
+
+int phase_switch( int p )
+{
+	double t = wall_time();
+	int prev = cur_phase;
+	
+	phase_time[ cur_phase ] += t - phase_start_time;
+	phase_start_time = t;
+	cur_phase = p;
+	return prev;
+}
+
+long peak_rss_kb( void )
+{
+#if defined( __unix__ ) || defined( __APPLE__ )
+	struct rusage ru;
+	
+	if ( getrusage( RUSAGE_SELF, &ru ) != 0 ) return 0;
+	#if defined( __APPLE__ )
+	return ru.ru_maxrss / 1024;  /* in bytes. */
+	#else
+	return ru.ru_maxrss;
+	#endif
+#else
+	return 0;
+#endif
+}
+
+/*
+	"ratio" is the space saved in percent, as in the text output;
+	"mb_per_s" is of the uncompressed bytes.
+*/
+void run_json( FILE *fp, const run_stats *r )
+{
+	double secs = run_time(), ratio = 0;
+	int64_t raw = strcmp( r->mode, "compress" ) ? r->bytes_out : r->bytes_in;
+	int i;
+	
+	phase_switch( cur_phase );
+	if ( raw > 0 ) {
+		ratio = strcmp( r->mode, "compress" ) ?
+			100.0 * (r->bytes_out - r->bytes_in) / r->bytes_out :
+			100.0 * (r->bytes_in - r->bytes_out) / r->bytes_in;
+	}
+	fprintf(fp, "{\"tool\":\"%s\",\"mode\":\"%s\",\"bytes_in\":%lld,\"bytes_out\":%lld,"
+		"\"ratio\":%.4f,\"seconds\":%.6f,\"mb_per_s\":%.3f,\"peak_rss_kb\":%ld,"
+		"\"code_max_bits\":%d,\"segments\":%lld,\"resets\":%lld,"
+		"\"bytes_stored\":%lld,\"bytes_bypassed\":%lld,\"bytes_run\":%lld,\"bytes_deduped\":%lld,\"phases\":{",
+		r->tool, r->mode, (long long) r->bytes_in, (long long) r->bytes_out,
+		ratio, secs, secs > 0 ? raw / 1048576.0 / secs : 0.0, peak_rss_kb(),
+		r->code_max_bits, (long long) r->segments, (long long) r->resets,
+		(long long) r->bytes_stored, (long long) r->bytes_bypassed,
+		(long long) r->bytes_run, (long long) r->bytes_deduped );
+	for ( i = 0; i < NPHASES; i++ ) {
+		fprintf(fp, "%s\"%s\":%.6f", i ? "," : "", phase_names[ i ], phase_time[ i ] );
+	}
+	fprintf(fp, "}}\n");
+}
@@ -0,0 +1,65 @@
+/* LZWRUN.H, wall-clock phase timers and run statistics, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWRUN_H )
+	#define LZWRUN_H
+
+/*
+	The phases of a run. Exactly one phase is current at any time
+	(PHASE_OTHER before the first switch), so the phase times add
+	up to the wall-clock time of the run.
+*/
+enum {
+	PHASE_OTHER,
+	PHASE_READ,      /* fread() of the input buffer. */
+	PHASE_MATCH,     /* the LZW matching kernel. */
+	PHASE_PACK,      /* packing the codes into bits. */
+	PHASE_DECODE,    /* the decoder. */
+	PHASE_WRITE,     /* fwrite() of the output buffer. */
+	PHASE_RESET,     /* string table resets. */
+	PHASE_SEARCH,    /* the search for the segments of the max mode. */
+	PHASE_SCAN,      /* the entropy pre-scan of the blocks. */
+	PHASE_DEDUP,     /* chunking, fingerprints and checks of --dedup. */
+	PHASE_CHECK,     /* the checksums of --crc. */
+	PHASE_FREE,      /* freeing the tables and buffers. */
+	NPHASES
+};
+
+extern const char *phase_names[ NPHASES ];
+extern double phase_time[ NPHASES ];
+extern int cur_phase;
+
+/* seconds from an arbitrary start; CLOCK_MONOTONIC where available. */
+double wall_time( void );
+
+/* starts the run clock. */
+void run_start( void );
+
+/* seconds since run_start(). */
+double run_time( void );
+
+/* makes p the current phase; returns the previous one. */
+int phase_switch( int p );
+
+/* peak resident set size in KB, or 0 if unknown. */
+long peak_rss_kb( void );
+
+/* the statistics of a run, printed by run_json(). */
+typedef struct {
+	const char *tool;
+	const char *mode;          /* "compress" or "decompress". */
+	int64_t bytes_in, bytes_out;
+	int code_max_bits;
+	int64_t segments;          /* string tables used (resets+1). */
+	int64_t resets;
+	int64_t bytes_stored;      /* input bytes stored raw (block mode). */
+	int64_t bytes_bypassed;    /* of those, not run through LZW (entropy pre-scan). */
+	int64_t bytes_run;         /* input bytes in RUN blocks (block mode). */
+	int64_t bytes_deduped;     /* input bytes in REF blocks (--dedup). */
+} run_stats;
+
+/* prints the run statistics as one line of JSON. */
+void run_json( FILE *fp, const run_stats *r );
+
+#endif
@@ -0,0 +1,129 @@
+/*
+	Filename:  LZWSCAN.C
+	
+	The entropy pre-scan of the block mode of lzwhc: a byte histogram
+	of a few samples of a block gives its order-0 entropy, and blocks
+	that are close to 8 bits per byte (compressed or encrypted data)
+	are stored raw without touching the dictionary.
+	
+	The histogram keeps four tables of counts, and takes 8 bytes per
+	load, so that runs of the same byte do not wait on one counter;
+	the sums are done once at the end. It runs at a few GB/s, and as
+	only the samples are scanned, at far more per byte of input.
+	
+	The run finder probes one 8-byte word every min-8 bytes, which no
+	run of min bytes can step over, and only extends the probes whose
+	8 bytes are all equal; it compares 8 bytes at a time.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include "lzwscan.h"
+
+void scan_histogram( const unsigned char *p, size_t n, uint32_t hist[ 256 ] )
+{
+	uint32_t h[ 4 ][ 256 ];
+	const unsigned char *end = p + n;
+	uint64_t w;
+	int i;
+	
+	memset( h, 0, sizeof(h) );
+	while ( end - p >= 8 ) {
+		memcpy( &w, p, 8 );
+		h[ 0 ][ w & 0xff ]++;
+		h[ 1 ][ (w >> 8) & 0xff ]++;
+		h[ 2 ][ (w >> 16) & 0xff ]++;
+		h[ 3 ][ (w >> 24) & 0xff ]++;
+		h[ 0 ][ (w >> 32) & 0xff ]++;
+		h[ 1 ][ (w >> 40) & 0xff ]++;
+		h[ 2 ][ (w >> 48) & 0xff ]++;
+		h[ 3 ][ w >> 56 ]++;
+		p += 8;
+	}
+	while ( p < end ) h[ 0 ][ *p++ ]++;
+	for ( i = 0; i < 256; i++ ) hist[ i ] += h[ 0 ][ i ] + h[ 1 ][ i ] + h[ 2 ][ i ] + h[ 3 ][ i ];
+}
+
+/*
+	log2(x) for x > 0, to about 0.00001: the exponent of the double,
+	plus a polynomial for the mantissa (no libm needed).
+*/
+static double scan_log2( double x )
+{
+	uint64_t b;
+	double m;
+	int e;
+	
+	memcpy( &b, &x, 8 );
+	e = (int) ((b >> 52) & 0x7ff) - 1023;
+	b = (b & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+	memcpy( &m, &b, 8 );  /* 1 <= m < 2. */
+	m -= 1;
+	return e + m * (1.4425449 + m * (-0.7181452 + m * (0.4575485
+		+ m * (-0.2779042 + m * (0.1217970 - m * 0.0258411)))));
+}
+
+double scan_entropy( const unsigned char *p, size_t n )
+{
+	uint32_t hist[ 256 ];
+	size_t total = 0, step;
+	double h = 0;
+	int i;
+	
+	memset( hist, 0, sizeof(hist) );
+	if ( n <= SCAN_SLICES * SCAN_SLICE ) {
+		scan_histogram( p, n, hist );
+		total = n;
+	}
+	else {
+		/* the first slice at the start of the block, the last at its end. */
+		step = (n - SCAN_SLICE) / (SCAN_SLICES - 1);
+		for ( i = 0; i < SCAN_SLICES; i++ ) {
+			scan_histogram( p + i * step, SCAN_SLICE, hist );
+		}
+		total = SCAN_SLICES * SCAN_SLICE;
+	}
+	if ( total == 0 ) return 0;
+	for ( i = 0; i < 256; i++ ) {
+		if ( hist[ i ] ) h -= hist[ i ] * scan_log2( (double) hist[ i ] / total );
+	}
+	return h / total;
+}
+
+/* the 8 bytes c c c c c c c c. */
+#define RUN_WORD( c )   ((uint64_t) (c) * 0x0101010101010101ULL)
+
+size_t scan_run( const unsigned char *p, size_t n, size_t min, size_t *len )
+{
+	size_t i = 0, s, e, step = min - 8;
+	uint64_t w, pat;
+	
+	*len = 0;
+	while ( i + 8 <= n ) {
+		memcpy( &w, p + i, 8 );
+		pat = RUN_WORD( p[ i ] );
+		if ( w != pat ) {
+			i += step;
+			continue;
+		}
+		/* a probe inside a run: find its ends. */
+		for ( s = i; s >= 8; s -= 8 ) {
+			memcpy( &w, p + s - 8, 8 );
+			if ( w != pat ) break;
+		}
+		while ( s > 0 && p[ s-1 ] == p[ i ] ) s--;
+		for ( e = i + 8; e + 8 <= n; e += 8 ) {
+			memcpy( &w, p + e, 8 );
+			if ( w != pat ) break;
+		}
+		while ( e < n && p[ e ] == p[ i ] ) e++;
+		if ( e - s >= min ) {
+			*len = e - s;
+			return s;
+		}
+		/* too short; the next run starts at e or after. */
+		i = e;
+	}
+	return n;
+}
@@ -0,0 +1,35 @@
+/* LZWSCAN.H, the pre-scans of the blocks of LZWHC (entropy, byte runs), 2024 */
+#include <stdint.h>  /* C99 */
+#include <stddef.h>
+
+#if !defined( LZWSCAN_H )
+	#define LZWSCAN_H
+
+/*
+	A block is sampled at SCAN_SLICES places, SCAN_SLICE bytes each
+	(the whole block if it is smaller); a 1MB block is scanned 1.6%.
+*/
+#define SCAN_SLICES        4
+#define SCAN_SLICE         4096
+
+/*
+	Blocks whose sample has at least this many bits per byte of
+	order-0 entropy are stored raw without running LZW. A random
+	sample of 16KB measures about 7.99.
+*/
+#define SCAN_ENTROPY_RAW   7.9
+
+/* adds the byte counts of p[0..n-1] to hist[]. */
+void scan_histogram( const unsigned char *p, size_t n, uint32_t hist[ 256 ] );
+
+/* the order-0 entropy, in bits per byte, of the sample of p[0..n-1]. */
+double scan_entropy( const unsigned char *p, size_t n );
+
+/*
+	Finds the first run of at least min (>= 16) copies of one byte in
+	p[0..n-1]: returns its offset and stores its length in *len, or
+	returns n with *len = 0 if there is none.
+*/
+size_t scan_run( const unsigned char *p, size_t n, size_t min, size_t *len );
+
+#endif
@@ -0,0 +1,150 @@
+/*
+	Filename:  LZWTRACE.C
+	
+	Begin/end spans of each thread, written at exit as Chrome
+	trace_event JSON (open in chrome://tracing or Perfetto).
+	
+	Every thread records into a ring buffer of its own, so recording
+	takes no lock: the ring is found through a thread-local pointer,
+	and it is added to the list of rings with a compare-and-swap the
+	first time the thread records an event. The rings are read when
+	the trace is written, after the worker threads are done.
+	
+	Needs GCC or Clang (__thread, __atomic) and CLOCK_MONOTONIC.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>  /* C99 */
+#include <time.h>
+#include "lzwtrace.h"
+
+int trace_enabled = 0;
+
+#if defined( LZW_TRACE )
+
+typedef struct {
+	uint64_t ts;          /* nanoseconds since trace_open(). */
+	const char *name;
+	char ph;
+} trace_rec;
+
+typedef struct trace_ring {
+	struct trace_ring *next;
+	int tid;
+	const char *thread_name;
+	uint64_t head;        /* events recorded; the ring holds the last TRACE_RING_SIZE. */
+	trace_rec ev[ TRACE_RING_SIZE ];
+} trace_ring;
+
+static trace_ring *rings = NULL;
+static int next_tid = 0;
+static __thread trace_ring *my_ring = NULL;
+static char *trace_filename = NULL;
+static uint64_t trace_t0;
+
+static uint64_t trace_clock( void )
+{
+	struct timespec ts;
+	
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* the ring of the calling thread, created on first use. */
+static trace_ring *get_ring( void )
+{
+	trace_ring *r = my_ring;
+	
+	if ( r ) return r;
+	r = (trace_ring *) malloc( sizeof(trace_ring) );
+	if ( !r ) return NULL;
+	r->head = 0;
+	r->thread_name = NULL;
+	r->tid = __atomic_fetch_add( &next_tid, 1, __ATOMIC_RELAXED );
+	r->next = __atomic_load_n( &rings, __ATOMIC_RELAXED );
+	while ( !__atomic_compare_exchange_n( &rings, &r->next, r, 1,
+		__ATOMIC_RELEASE, __ATOMIC_RELAXED ) )
+		;
+	return my_ring = r;
+}
+
+void trace_event( const char *name, char ph )
+{
+	trace_ring *r = get_ring();
+	trace_rec *e;
+	
+	if ( !r ) return;
+	e = &r->ev[ r->head & (TRACE_RING_SIZE-1) ];
+	e->ts = trace_clock() - trace_t0;
+	e->name = name;
+	e->ph = ph;
+	r->head++;
+}
+
+void trace_thread_name( const char *name )
+{
+	trace_ring *r;
+	
+	if ( !trace_enabled || (r = get_ring()) == NULL ) return;
+	r->thread_name = name;
+}
+
+void trace_dump( void )
+{
+	trace_ring *r;
+	uint64_t i;
+	FILE *fp;
+	int first = 1;
+	
+	if ( !trace_enabled ) return;
+	trace_enabled = 0;
+	if ( (fp = fopen( trace_filename, "w" )) == NULL ) {
+		fprintf(stderr, "\nError writing trace file %s.", trace_filename );
+		return;
+	}
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for ( r = __atomic_load_n( &rings, __ATOMIC_ACQUIRE ); r; r = r->next ) {
+		if ( r->thread_name ) {
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+				"\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", r->tid, r->thread_name );
+			first = 0;
+		}
+		i = r->head > TRACE_RING_SIZE ? r->head - TRACE_RING_SIZE : 0;
+		for ( ; i < r->head; i++ ) {
+			trace_rec *e = &r->ev[ i & (TRACE_RING_SIZE-1) ];
+			
+			fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+				first ? "" : ",\n", e->name, e->ph, e->ts / 1000.0, r->tid );
+			first = 0;
+		}
+	}
+	fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose( fp );
+}
+
+int trace_open( const char *filename )
+{
+	trace_filename = (char *) malloc( strlen( filename ) + 1 );
+	if ( !trace_filename ) return 0;
+	strcpy( trace_filename, filename );
+	trace_t0 = trace_clock();
+	trace_enabled = 1;
+	atexit( trace_dump );
+	return 1;
+}
+
+#else
+
+void trace_event( const char *name, char ph ) { (void) name; (void) ph; }
+void trace_thread_name( const char *name ) { (void) name; }
+void trace_dump( void ) { }
+
+int trace_open( const char *filename )
+{
+	(void) filename;
+	fprintf(stderr, "\nTracing is not compiled in (compile with -DLZW_TRACE).");
+	return 0;
+}
+
+#endif
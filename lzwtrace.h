@@ -0,0 +1,43 @@
+/* LZWTRACE.H, begin/end spans in Chrome trace_event format, 2024 */
+#include <stdio.h>
+#include <stdint.h>  /* C99 */
+
+#if !defined( LZWTRACE_H )
+	#define LZWTRACE_H
+
+/*
+	TRACE_BEGIN( name ) and TRACE_END( name ) mark a span of the
+	calling thread; name must be a string constant. They compile to
+	nothing unless LZW_TRACE is defined, and to one test of
+	trace_enabled when it is defined but trace_open() was not called.
+*/
+#if defined( LZW_TRACE )
+	#define TRACE_BEGIN( name )  do { if ( trace_enabled ) trace_event( (name), 'B' ); } while ( 0 )
+	#define TRACE_END( name )    do { if ( trace_enabled ) trace_event( (name), 'E' ); } while ( 0 )
+#else
+	#define TRACE_BEGIN( name )
+	#define TRACE_END( name )
+#endif
+
+/* events kept per thread; older ones are overwritten. */
+#define TRACE_RING_SIZE  (1<<16)
+
+extern int trace_enabled;
+
+/*
+	Starts tracing; the trace is written to filename at exit.
+	Returns 0 if tracing is not compiled in (LZW_TRACE) or the
+	file cannot be created.
+*/
+int  trace_open( const char *filename );
+
+/* names the calling thread in the trace. */
+void trace_thread_name( const char *name );
+
+/* records an event of the calling thread; ph is 'B' (begin) or 'E' (end). */
+void trace_event( const char *name, char ph );
+
+/* writes the trace file now (also done at exit). */
+void trace_dump( void );
+
+#endif
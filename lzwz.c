@@ -15,7 +15,8 @@
 	
 	where N is bitsize of dictionary table size CODE_MAX. N is optional (default=16) 
 	and N >= 12. After CODE_MAX+4K codes are transmitted, we reset the string table.
-	-nr option to not reset the string table.
+	-nr option to not reset the string table. The exit status of -d is 1
+	if the file fails to decode.
 	
 	Version 1.1 - Optional dictionary table size (9/21/2022); single file codec.
 	Version 1.2 - Compression option to not reset dictionary (12/09/2022).
@@ -29,6 +30,8 @@
 #include <time.h>
 #include "utypes.h"
 #include "gtbitio3.c"
+#include "lzwrun.c"
+#include "lzwhdr.c"
 
 #define EOF_LZW_CODE     256
 #define LZW_NULL         256
@@ -42,20 +45,15 @@ enum {
 	DECOMPRESS,
 };
 
-typedef struct {
-	char algorithm[4];
-	int code_max_bits;
-	int reset_dict;
-} file_stamp;
-
 /* code tables */
 int *code;
 int *prefix;
 unsigned char *character;
-unsigned char *stack_buffer, *stack=NULL;
+unsigned char *out, *stack=NULL;
+int *phrase_len;
 
 int prefix_string_code = 0, lzw_code_cnt = 0;
-int old_lzw_code = 0, new_lzw_code = 0, lzwcode;
+int old_lzw_code = 0, new_lzw_code = 0, lzwcode, len;
 int c = 0, code_max_bits = 16, /* default 65536 table size */
 	code_MAX, hash_TABLE_SIZE, hash_SHIFT;
 int reset_dict = 1; /* default = reset. */
@@ -64,7 +62,11 @@ int bit_count = 9;  /* code size starts at 9 bits. */
 int code_max = 512; /* start expanding the code size if we
                          already reached this value. */
 
+/* bad codes found by the decoder. */
+int decode_errors = 0;
+
 void copyright( void );
+void bad_code( int c );
 void compress_LZW( void );
 void decompress_LZW( void );
 
@@ -81,6 +83,73 @@ void init_code_table( void )
     }
 }
 
+/*
+	Sets hash_TABLE_SIZE, hash_SHIFT and code_MAX for code_max_bits,
+	and allocates the code tables of mode (again, for a member of
+	another code size). Returns 0 if out of memory.
+*/
+int alloc_code_tables( int mode )
+{
+	if ( code ) free( code );
+	if ( prefix ) free( prefix );
+	if ( character ) free( character );
+	if ( phrase_len ) free( phrase_len );
+	code = prefix = phrase_len = NULL;
+	character = NULL;
+	
+	/* Set hash_TABLE_SIZE, hash_SHIFT, and code_MAX. */
+	switch ( code_max_bits ) {
+		case 12: hash_TABLE_SIZE =      5021; break;
+		case 13: hash_TABLE_SIZE =      9859; break;
+		case 14: hash_TABLE_SIZE =     18041; break;
+		case 15: hash_TABLE_SIZE =     35023; break;
+		case 16: hash_TABLE_SIZE =     69001; break;
+		case 17: hash_TABLE_SIZE =    134989; break;
+		case 18: hash_TABLE_SIZE =    279991; break;
+		case 19: hash_TABLE_SIZE =    539881; break;
+		case 20: hash_TABLE_SIZE =   1249943; break;
+		case 21: hash_TABLE_SIZE =   2157151; break;
+		case 22: hash_TABLE_SIZE =   4225303; break;
+		case 23: hash_TABLE_SIZE =   8500249; break;
+		case 24: hash_TABLE_SIZE =  16795123; break;
+		case 25: hash_TABLE_SIZE =  33559021; break;
+		case 26: hash_TABLE_SIZE =  67125433; break;
+		case 27: hash_TABLE_SIZE = 134253857; break;
+		case 28: hash_TABLE_SIZE = 268470641; break;
+		default: break;
+	}
+	hash_SHIFT = code_max_bits - 8;
+	code_MAX = 1 << code_max_bits;
+	
+	/* Allocate memory for the code tables. */
+	if ( mode == COMPRESS ){
+		code = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
+		if ( !code ) {
+			fprintf(stderr, "\n Error alloc: code buffer.");
+			return 0;
+		}
+	}
+	else if ( mode == DECOMPRESS ){
+		/* allocate memory for the string lengths. */
+		phrase_len = (int *) malloc( sizeof(int) * code_MAX );
+		if ( !phrase_len ) {
+			fprintf(stderr, "\n Error alloc: phrase_len buffer.");
+			return 0;
+		}
+	}
+	prefix = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
+	if ( !prefix ) {
+		fprintf(stderr, "\n Error alloc: prefix buffer.");
+		return 0;
+	}
+	character = (unsigned char *) malloc( sizeof(unsigned char) * hash_TABLE_SIZE );
+	if ( !character ) {
+		fprintf(stderr, "\n Error alloc: character buffer.");
+		return 0;
+	}
+	return 1;
+}
+
 /*
 	The insertion routine for the compressor, uses
 	hashing to store the codes in the code tables.
@@ -122,6 +191,7 @@ void insert_stringDEC( int prefix_code, unsigned char c )
 {
 	prefix[ lzw_code_cnt ] = prefix_code;
 	character[ lzw_code_cnt ] = c;
+	phrase_len[ lzw_code_cnt ] = phrase_len[ prefix_code ] + 1;
 }
 
 /*
@@ -172,10 +242,11 @@ void usage( void )
 int main( int argc, char *argv[] )
 {
 	float ratio = 0.0;
-	file_stamp fstamp;
+	lzw_header hdr, next;
 	int mode = -1, in_argn = 0, out_argn = 0, fcount = 0, n;
+	int64_t member_at, member_out = 0;
 	
-	clock_t start_time = clock();
+	double start_time = wall_time(), secs;
 	init_buffer_sizes( 1<<20 );
 	
 	/* command-line handler */
@@ -233,74 +304,30 @@ int main( int argc, char *argv[] )
 	
 	/* If DECOMPRESS mode, read input file and get code_max_bits. */
 	if ( mode == DECOMPRESS ) {
-		/* Read file stamp to get code_max_bits. */
-		fread( &fstamp, sizeof(file_stamp), 1, gIN );
-		code_max_bits = fstamp.code_max_bits;
-		reset_dict = fstamp.reset_dict;
-		init_get_buffer();
-		nbytes_read = sizeof(file_stamp);
-	}
-	
-	/* Set hash_TABLE_SIZE, hash_SHIFT, and code_MAX. */
-	switch ( code_max_bits ) {
-		case 12: hash_TABLE_SIZE =      5021; break;
-		case 13: hash_TABLE_SIZE =      9859; break;
-		case 14: hash_TABLE_SIZE =     18041; break;
-		case 15: hash_TABLE_SIZE =     35023; break;
-		case 16: hash_TABLE_SIZE =     69001; break;
-		case 17: hash_TABLE_SIZE =    134989; break;
-		case 18: hash_TABLE_SIZE =    279991; break;
-		case 19: hash_TABLE_SIZE =    539881; break;
-		case 20: hash_TABLE_SIZE =   1249943; break;
-		case 21: hash_TABLE_SIZE =   2157151; break;
-		case 22: hash_TABLE_SIZE =   4225303; break;
-		case 23: hash_TABLE_SIZE =   8500249; break;
-		case 24: hash_TABLE_SIZE =  16795123; break;
-		case 25: hash_TABLE_SIZE =  33559021; break;
-		case 26: hash_TABLE_SIZE =  67125433; break;
-		case 27: hash_TABLE_SIZE = 134253857; break;
-		case 28: hash_TABLE_SIZE = 268470641; break;
-		default: break;
-	}
-	hash_SHIFT = code_max_bits - 8;
-	code_MAX = 1 << code_max_bits;
-	
-	/* Allocate memory for the code tables. */
-	if ( mode == COMPRESS ){
-		code = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
-		if ( !code ) {
-			fprintf(stderr, "\n Error alloc: code buffer.");
+		/* Read the header (or the old file stamp) to get code_max_bits. */
+		if ( !(n = hdr_read( gIN, &hdr, 2 )) ) {
+			fprintf(stderr, "\nError: not an LZW file.");
+			decode_errors++;
 			goto halt_prog;
 		}
-	}
-	else if ( mode == DECOMPRESS ){
-		/* allocate memory for the stack buffer. */
-		stack_buffer = (unsigned char *) malloc( sizeof(unsigned char) * code_MAX );
-		if ( !stack_buffer ) {
-			fprintf(stderr, "\n Error alloc: stack buffer.");
+		if ( !hdr_check( &hdr, HDR_LZWZ ) ) {
+			decode_errors++;
 			goto halt_prog;
 		}
-	}
-	prefix = (int *) malloc( sizeof(int) * hash_TABLE_SIZE );
-	if ( !prefix ) {
-		fprintf(stderr, "\n Error alloc: prefix buffer.");
-		goto halt_prog;
-	}
-	character = (unsigned char *) malloc( sizeof(unsigned char) * hash_TABLE_SIZE );
-	if ( !character ) {
-		fprintf(stderr, "\n Error alloc: character buffer.");
-		goto halt_prog;
+		code_max_bits = hdr.bits;
+		reset_dict = hdr.legacy ? hdr.legacy_int[ 1 ] : hdr.policy == HDR_RESET_BLIND;
+		init_get_buffer();
+		nbytes_read = n;
 	}
 	
+	if ( !alloc_code_tables( mode ) ) goto halt_prog;
+	
 	/* Finally, compress or decompress input file. */
 	if ( mode == COMPRESS ){
 		init_get_buffer();
-		/* Write the FILE STAMP. */
-		strcpy( fstamp.algorithm, "LZW" );
-		fstamp.code_max_bits = code_max_bits;
-		fstamp.reset_dict = reset_dict;
-		fwrite( &fstamp, sizeof(file_stamp), 1, pOUT );
-		nbytes_out = sizeof(file_stamp);
+		/* Write the header (see LZWHDR.H). */
+		hdr_init( &hdr, HDR_LZWZ, reset_dict ? HDR_RESET_BLIND : HDR_RESET_NONE, code_max_bits, gIN );
+		nbytes_out = hdr_write( pOUT, &hdr );
 		
 		fprintf(stderr, "\nDictionary size used   = %15lu codes", (ulong) code_MAX );
 		
@@ -310,8 +337,36 @@ int main( int argc, char *argv[] )
 	else if ( mode == DECOMPRESS ){
 		fprintf(stderr, "\nLZW Decoding...");
 		decompress_LZW();
+		
+		/* the next members of files joined with cat (see LZWHDR.H). */
+		while ( !decode_errors && !hdr.legacy
+			&& (n = hdr_next_member( gIN, member_at = get_nbytes_used(), &next )) > 0 ) {
+			flush_put_buffer();
+			if ( !hdr_check_size( &hdr, nbytes_out - member_out ) || !hdr_check( &next, HDR_LZWZ ) ) {
+				decode_errors++;
+				break;
+			}
+			if ( next.bits != code_max_bits ) {
+				code_max_bits = next.bits;
+				if ( !alloc_code_tables( mode ) ) {
+					decode_errors++;
+					break;
+				}
+			}
+			hdr = next;
+			reset_dict = hdr.policy == HDR_RESET_BLIND;
+			member_out = nbytes_out;
+			free_get_buffer();
+			init_get_buffer();
+			nbytes_read = member_at + n;
+			decompress_LZW();
+		}
+		if ( n < 0 ) fprintf(stderr, "\nWarning: bytes after the last member, ignored.");
 	}
 	flush_put_buffer();
+	/* (the size of the last member; the loop above checked the others.) */
+	if ( mode == DECOMPRESS && !decode_errors && !hdr_check_size( &hdr, nbytes_out - member_out ) )
+		decode_errors++;
 	nbytes_read = get_nbytes_read();
 	
 	fprintf(stderr, "done.\n %s (%lld) -> %s (%lld)", argv[in_argn], nbytes_read, argv[out_argn], nbytes_out);
@@ -327,14 +382,27 @@ int main( int argc, char *argv[] )
 	if ( code ) free( code );
 	if ( prefix ) free( prefix );
 	if ( character ) free( character );
-	if ( stack_buffer ) free( stack_buffer );
+	if ( phrase_len ) free( phrase_len );
 	fclose( gIN );
 	fclose( pOUT );
 	
 	if ( mode == DECOMPRESS ) nbytes_read = nbytes_out;
+	secs = wall_time() - start_time;
 	fprintf(stderr, " in %3.2f secs (@ %3.2f MB/s)\n",
-		(double)(clock()-start_time)/CLOCKS_PER_SEC, (nbytes_read/1048576)/((double)(clock()-start_time)/CLOCKS_PER_SEC) );
-	return 0;
+		secs, secs > 0 ? (nbytes_read / 1048576.0) / secs : 0.0 );
+	return decode_errors != 0;
+}
+
+/*
+	Reports a code that cannot come next in the stream, or the end of
+	the input before the END-of-FILE code, with the output byte there.
+*/
+void bad_code( int c )
+{
+	if ( nfread == 0 ) fprintf(stderr, "\nError: the input ends before the END-of-FILE code, at output byte %lld.",
+		(long long) (nbytes_out + pbuf_count) );
+	else fprintf(stderr, "\nError: bad code %d at output byte %lld.", c, (long long) (nbytes_out + pbuf_count) );
+	decode_errors++;
 }
 
 void copyright( void )
@@ -393,11 +461,19 @@ void compress_LZW( void )
 
 void decompress_LZW( void )
 {
+	for ( len = 0; len < 256; len++ ) phrase_len[ len ] = 1;
+	
 	/* set the starting code to define. */
 	lzw_code_cnt = START_LZW_CODE;
+	bit_count = 9;
+	code_max = 512;
 	
 	/* get first code. */
 	old_lzw_code = get_nbits( bit_count );
+	if ( old_lzw_code > 255 ) {
+		bad_code( old_lzw_code );
+		return;
+	}
 	
 	/* first code is a character; output it. */
 	pfputc( (unsigned char) old_lzw_code );
@@ -406,28 +482,35 @@ void decompress_LZW( void )
 		new_lzw_code = get_nbits( bit_count );
 		
 		if ( new_lzw_code == EOF_LZW_CODE ) break;
+		else if ( nfread == 0 || new_lzw_code > lzw_code_cnt ) {
+			bad_code( new_lzw_code );
+			break;
+		}
 		else if ( new_lzw_code >= lzw_code_cnt ) lzwcode = old_lzw_code;
 		else lzwcode = new_lzw_code;
 		
-		/* GET STRING/PATTERN. */
-		stack = stack_buffer;
+		/* reserve the string (and K, if undefined code) in the output buffer. */
+		len = phrase_len[ lzwcode ];
+		out = pfreserve( len+1 );
+		
+		/* GET STRING/PATTERN; write it back to front at its final position. */
+		stack = out + len;
 		while ( lzwcode > EOF_LZW_CODE ) {
-			*stack++ = character[ lzwcode ];
+			*--stack = character[ lzwcode ];
 			/* when loop exits, lzwcode must be a character. */
 			lzwcode = prefix[ lzwcode ];
 		}
 		
 		/* K = get first character of string. */
-		*stack = lzwcode;
+		*--stack = lzwcode;
 		
-		/* OUTPUT STRING/PATTERN. */
-		while ( stack >= stack_buffer ) {
-			pfputc( *stack-- );
-		}
 		/* if undefined code. */
 		if ( new_lzw_code >= lzw_code_cnt ) {
-			pfputc( lzwcode );
+			out[ len++ ] = lzwcode;
 		}
+		
+		/* OUTPUT STRING/PATTERN. */
+		pfcommit( len );
 
 		/* add PREV_CODE+K to the string table. */
 		if ( lzw_code_cnt < code_MAX ) {
@@ -451,6 +534,11 @@ void decompress_LZW( void )
 			
 			/* get first code. */
 			old_lzw_code = get_nbits( bit_count );
+			if ( old_lzw_code == EOF_LZW_CODE ) break;
+			if ( nfread == 0 || old_lzw_code > 255 ) {
+				bad_code( old_lzw_code );
+				break;
+			}
 			
 			/* first code is a character; output it. */
 			pfputc( (unsigned char) old_lzw_code );